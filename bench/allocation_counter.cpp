@@ -0,0 +1,43 @@
+//
+//  allocation_counter.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// the replacements are kept in their own translation unit so that they are
+// never inlined next to the new and delete expressions
+static unsigned long allocation_count = 0;
+static unsigned long allocation_bytes = 0;
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    allocation_bytes += size;
+    void* pointer = std::malloc(size != 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+unsigned long bench::allocations()
+{
+    return allocation_count;
+}
+
+unsigned long bench::allocated_bytes()
+{
+    return allocation_bytes;
+}
@@ -0,0 +1,22 @@
+//
+//  allocation_counter.hpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#ifndef __Grammar2Code__AllocationCounter__
+#define __Grammar2Code__AllocationCounter__
+
+namespace bench {
+
+    // allocations done through the global operator new since the start,
+    // pugixml allocates its nodes with malloc and is not counted
+    unsigned long allocations();
+
+    unsigned long allocated_bytes();
+
+}
+
+#endif /* defined(__Grammar2Code__AllocationCounter__) */
@@ -0,0 +1,164 @@
+//
+//  grammar2code_bench.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+#include "allocation_counter.hpp"
+#include "synthetic_grammar.hpp"
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct phase {
+    std::string name;
+    std::vector<double> milliseconds;
+    unsigned long allocations;
+    unsigned long bytes;
+};
+
+// runs task once and adds its time and allocations to the phase with the
+// given name, phases are reported in the order they are first measured
+static void measure(std::vector<phase>& phases, const std::string& name, const std::function<void()>& task)
+{
+    auto it = std::find_if(phases.begin(), phases.end(), [&name](const phase& p) { return p.name == name; });
+    if (it == phases.end()) {
+        phases.push_back(phase{name, {}, 0, 0});
+        it = phases.end() - 1;
+    }
+    unsigned long allocations_before = bench::allocations();
+    unsigned long bytes_before = bench::allocated_bytes();
+    auto start = std::chrono::steady_clock::now();
+    task();
+    auto end = std::chrono::steady_clock::now();
+    it->milliseconds.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    it->allocations += bench::allocations() - allocations_before;
+    it->bytes += bench::allocated_bytes() - bytes_before;
+}
+
+static void report(const std::vector<phase>& phases)
+{
+    std::cout << std::left << std::setw(18) << "phase" << std::right << std::setw(6) << "runs";
+    std::cout << std::setw(14) << "median ms" << std::setw(14) << "min ms";
+    std::cout << std::setw(14) << "allocs/run" << std::setw(14) << "bytes/run" << std::endl;
+    for (auto& p : phases) {
+        std::vector<double> sorted(p.milliseconds);
+        std::sort(sorted.begin(), sorted.end());
+        size_t runs = sorted.size();
+        std::cout << std::left << std::setw(18) << p.name << std::right << std::setw(6) << runs;
+        std::cout << std::fixed << std::setprecision(3) << std::setw(14) << sorted[runs / 2] << std::setw(14) << sorted[0];
+        std::cout << std::setw(14) << p.allocations / runs << std::setw(14) << p.bytes / runs << std::endl;
+    }
+}
+
+int main(int argc, const char * argv[])
+{
+    Error::set_exec_name(boost::filesystem::path(argv[0]).filename().string());
+
+    boost::program_options::options_description desc("Options");
+    desc.add_options()
+        ("help,h", "this help message")
+        ("grammar,g", boost::program_options::value<std::string>(), "grammar xml file to measure instead of a synthetic one")
+        ("breadth", boost::program_options::value<int>()->default_value(4), "alternatives of each synthetic rule")
+        ("levels", boost::program_options::value<int>()->default_value(4), "levels of synthetic rules")
+        ("recursion", boost::program_options::value<std::string>()->default_value("right"), "shape of the synthetic recursive rule: 'none', 'right', 'left' or 'tree'")
+        ("cdata", boost::program_options::value<int>()->default_value(64), "size in bytes of the synthetic CDATA sections")
+        ("includes", boost::program_options::value<int>()->default_value(0), "number of files the synthetic rules are split into")
+        ("depth,d", boost::program_options::value<int>()->default_value(3), "maximum depth of the recursions")
+        ("samples", boost::program_options::value<int>()->default_value(100), "configurations sampled and generated at each repetition")
+        ("repetitions,r", boost::program_options::value<int>()->default_value(5), "repetitions of each phase")
+        ("seed", boost::program_options::value<unsigned long>()->default_value(1), "seed of the sampled configurations")
+    ;
+    boost::program_options::variables_map vm;
+    boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+    if (vm.count("help")) {
+        std::cout << "Measures the time and the allocations of each phase of grammar2code." << std::endl;
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    boost::filesystem::path work_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("g2c_bench_%%%%%%");
+    boost::filesystem::path grammar_xml;
+    if (vm.count("grammar") != 0) {
+        grammar_xml = vm["grammar"].as<std::string>();
+    } else {
+        bench::synthetic_grammar_options options;
+        options.breadth = vm["breadth"].as<int>();
+        options.depth = vm["levels"].as<int>();
+        options.recursion = vm["recursion"].as<std::string>();
+        options.cdata_size = vm["cdata"].as<int>();
+        options.includes = vm["includes"].as<int>();
+        grammar_xml = bench::write_synthetic_grammar(options, work_dir / "grammar");
+    }
+    int depth = vm["depth"].as<int>();
+    int samples = vm["samples"].as<int>();
+    int repetitions = std::max(1, vm["repetitions"].as<int>());
+    std::vector<std::string> formats = {"irace", "paramils", "smac", "crace", "emili"};
+
+    // the messages of the clean up and of the code generation are discarded
+    std::ostream null_stream(nullptr);
+    std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+    std::vector<phase> phases;
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        std::shared_ptr<grammar::model> ruleset;
+        // the clean up reports also on the standard error
+        std::streambuf* cerr_buffer = std::cerr.rdbuf(nullptr);
+        measure(phases, "model", [&]() {
+            ruleset = std::make_shared<grammar::model>(grammar_xml, boost::filesystem::path());
+        });
+        std::cerr.rdbuf(cerr_buffer);
+        std::cerr.clear();
+        for (auto& format : formats) {
+            measure(phases, "walk " + format, [&]() {
+                grammar::configuration::make(format, ruleset, depth)->print(null_stream);
+            });
+            // the list-like recursions encoded by their count
+            measure(phases, "walk " + format + " reps", [&]() {
+                auto configuration = grammar::configuration::make(format, ruleset, depth);
+                configuration->set_recursion_count(true);
+                configuration->print(null_stream);
+            });
+        }
+        measure(phases, "count", [&]() {
+            grammar::design_space space(ruleset, depth);
+            space.count();
+        });
+        std::vector<std::vector<std::pair<std::string, std::string>>> configurations;
+        measure(phases, "sample", [&]() {
+            grammar::sampler sampler(ruleset, depth, vm["seed"].as<unsigned long>());
+            for (int i = 0; i < samples; ++i) {
+                configurations.push_back(sampler.sample());
+            }
+        });
+        measure(phases, "generate", [&]() {
+            for (size_t i = 0; i < configurations.size(); ++i) {
+                std::unordered_map<std::string, std::string> parameters(configurations[i].begin(), configurations[i].end());
+                grammar::params2code p2c(ruleset, parameters, work_dir / "code" / std::to_string(i), null_stream, false);
+                p2c.set_max_depth(depth);
+                p2c.generate_code();
+            }
+        });
+    }
+    std::cout.rdbuf(cout_buffer);
+    std::cout.clear();
+    boost::filesystem::remove_all(work_dir);
+
+    std::cout << "grammar: " << (vm.count("grammar") != 0 ? grammar_xml.string() : "synthetic");
+    std::cout << ", depth: " << depth << ", samples: " << samples << std::endl << std::endl;
+    report(phases);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+//
+//  synthetic_grammar.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "synthetic_grammar.hpp"
+#include "error.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string rule_name(int level, int index)
+{
+    return "l" + std::to_string(level) + "_" + std::to_string(index);
+}
+
+// the label makes every CDATA distinct, otherwise the clean up of the model
+// would merge the rules as duplicates
+static std::string cdata(const std::string& label, int size)
+{
+    std::string text = "/* " + label + " ";
+    if (static_cast<int>(text.size()) + 3 < size) {
+        text += std::string(size - text.size() - 3, '.');
+    }
+    return "<![CDATA[" + text + " */\n]]>";
+}
+
+static std::string recursive_rule(const std::string& shape, int size)
+{
+    std::string stop = cdata("rec stop", size) + "<rec_value type=\"int\" min=\"0\" max=\"9\" stepIfEnumerated=\"1\"/>";
+    std::string prefix = cdata("rec prefix", size);
+    std::string suffix = cdata("rec suffix", size);
+    std::string recursive;
+    if (shape == "right") {
+        recursive = prefix + "<rec/>";
+    } else if (shape == "left") {
+        recursive = "<rec/>" + suffix;
+    } else if (shape == "tree") {
+        recursive = prefix + "<rec/>" + suffix + "<rec/>";
+    } else {
+        Error::fatal("Unknown recursion shape " + shape + ".");
+    }
+    return "<rec>" + stop + "<or/>" + recursive + "</rec>\n";
+}
+
+static void write_file(const boost::filesystem::path& file, const std::string& content)
+{
+    std::ofstream fout(file.string());
+    if (!fout.good()) {
+        Error::fatal("Could not write " + file.string() + ".");
+    }
+    fout << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n" << content;
+}
+
+boost::filesystem::path bench::write_synthetic_grammar(const synthetic_grammar_options& options,
+                                                       const boost::filesystem::path& directory)
+{
+    if (options.breadth < 1 || options.depth < 1 || options.includes < 0) {
+        Error::fatal("The synthetic grammar needs breadth and depth of at least 1, and no negative includes.");
+    }
+    boost::filesystem::create_directories(directory);
+
+    // rules of each level, the last level ends with ranges
+    std::vector<std::string> rules;
+    for (int level = 0; level < options.depth; ++level) {
+        int rules_in_level = level == 0 ? 1 : options.breadth;
+        for (int index = 0; index < rules_in_level; ++index) {
+            std::string name = rule_name(level, index);
+            std::ostringstream rule;
+            rule << "<" << name << ">";
+            for (int alternative = 0; alternative < options.breadth; ++alternative) {
+                if (alternative > 0) {
+                    rule << "<or/>";
+                }
+                rule << cdata(name + " " + std::to_string(alternative), options.cdata_size);
+                if (level + 1 < options.depth) {
+                    rule << "<" << rule_name(level + 1, alternative) << "/>";
+                } else if (alternative == 0) {
+                    rule << "<value type=\"real\" min=\"0\" max=\"1\" stepIfEnumerated=\"0.25\"/>";
+                }
+            }
+            rule << "</" << name << ">\n";
+            rules.push_back(rule.str());
+        }
+    }
+    bool recursion = options.recursion != "none";
+    if (recursion) {
+        rules.push_back(recursive_rule(options.recursion, options.cdata_size));
+    }
+
+    // rules split round robin among the included files
+    std::vector<std::string> parts(options.includes);
+    std::ostringstream main;
+    main << "<gr:grammar xmlns:gr=\"grammar\">\n";
+    for (int i = 0; i < options.includes; ++i) {
+        main << "<gr:include source=\"part" << i << ".xml\"/>\n";
+    }
+    main << "<gr:derivations>\n";
+    main << "<start output=\"main.c\">" << cdata("start", options.cdata_size) << "<" << rule_name(0, 0) << "/>";
+    if (recursion) {
+        main << "<rec/>";
+    }
+    main << "</start>\n";
+    for (size_t i = 0; i < rules.size(); ++i) {
+        if (options.includes > 0) {
+            parts[i % options.includes] += rules[i];
+        } else {
+            main << rules[i];
+        }
+    }
+    main << "</gr:derivations>\n</gr:grammar>\n";
+
+    for (int i = 0; i < options.includes; ++i) {
+        write_file(directory / ("part" + std::to_string(i) + ".xml"),
+                   "<gr:grammar xmlns:gr=\"grammar\">\n<gr:derivations>\n" + parts[i] + "</gr:derivations>\n</gr:grammar>\n");
+    }
+    boost::filesystem::path grammar = directory / "grammar.xml";
+    write_file(grammar, main.str());
+    return grammar;
+}
@@ -0,0 +1,40 @@
+//
+//  synthetic_grammar.hpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#ifndef __Grammar2Code__SyntheticGrammar__
+#define __Grammar2Code__SyntheticGrammar__
+
+#include <boost/filesystem.hpp>
+
+#include <string>
+
+namespace bench {
+
+    // shape of a synthetic grammar: depth levels of rules with breadth
+    // alternatives each, where every alternative of a level calls a different
+    // rule of the next level, plus a recursive rule
+    struct synthetic_grammar_options {
+        int breadth;
+        int depth;
+        // none, right (A ::= S | P A), left (A ::= S | A Q) or tree
+        // (A ::= S | P A Q A)
+        std::string recursion;
+        // size in bytes of the CDATA of each alternative
+        int cdata_size;
+        // number of files, included by the main one, the rules are split
+        // into (0 for a single file)
+        int includes;
+    };
+
+    // writes the grammar in directory and returns the path of the main file
+    boost::filesystem::path write_synthetic_grammar(const synthetic_grammar_options &options,
+                                                    const boost::filesystem::path &directory);
+
+}
+
+#endif /* defined(__Grammar2Code__SyntheticGrammar__) */
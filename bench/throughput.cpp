@@ -0,0 +1,276 @@
+//
+//  throughput.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct mode_result {
+    std::string mode;
+    int processes;
+    double seconds;
+    int failures;
+    std::vector<double> latencies;
+};
+
+static std::string shell_quote(const std::string& text)
+{
+    return "'" + boost::replace_all_copy(text, "'", "'\\''") + "'";
+}
+
+static double milliseconds(bench_clock::time_point start, bench_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// nearest rank percentile
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(p * values.size()));
+    return values[std::max<size_t>(rank, 1) - 1];
+}
+
+static std::string candidate_command(const std::string& executable, const std::string& grammar_xml,
+                                     const boost::filesystem::path& target_dir, int depth,
+                                     const std::vector<std::pair<std::string, std::string>>& assignment)
+{
+    std::string command = shell_quote(executable) + " " + shell_quote(grammar_xml) + " -t " + shell_quote(target_dir.string());
+    command += " -d " + std::to_string(depth);
+    for (auto& param : assignment) {
+        command += " " + shell_quote("--" + param.first + "=" + param.second);
+    }
+    return command + " > /dev/null 2>&1";
+}
+
+// one process per candidate, jobs processes at a time
+static mode_result run_processes(const std::string& mode, int jobs, const std::string& executable,
+                                 const std::string& grammar_xml, const boost::filesystem::path& target_dir, int depth,
+                                 const std::vector<std::vector<std::pair<std::string, std::string>>>& configurations)
+{
+    mode_result result{mode, jobs, 0, 0, std::vector<double>(configurations.size())};
+    std::atomic<size_t> next(0);
+    std::atomic<int> failures(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < configurations.size(); i = next++) {
+            std::string command = candidate_command(executable, grammar_xml, target_dir / std::to_string(i + 1), depth, configurations[i]);
+            auto start = bench_clock::now();
+            int status = std::system(command.c_str());
+            result.latencies[i] = milliseconds(start, bench_clock::now());
+            if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                ++failures;
+            }
+        }
+    };
+    auto start = bench_clock::now();
+    std::vector<std::thread> threads;
+    for (int j = 0; j < jobs; ++j) {
+        threads.push_back(std::thread(worker));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    result.seconds = milliseconds(start, bench_clock::now()) / 1000;
+    result.failures = failures;
+    return result;
+}
+
+// a single process for all the candidates, the latency of each candidate is
+// the time between the lines that announce two consecutive candidates
+static mode_result run_batch(const std::string& executable, const std::string& grammar_xml,
+                             const boost::filesystem::path& target_dir, int depth, const boost::filesystem::path& batch_file,
+                             size_t candidates)
+{
+    mode_result result{"batch", 1, 0, 0, {}};
+    std::string command = shell_quote(executable) + " " + shell_quote(grammar_xml) + " -t " + shell_quote(target_dir.string());
+    command += " -d " + std::to_string(depth);
+    command += " -b " + shell_quote(batch_file.string()) + " 2> /dev/null";
+    auto start = bench_clock::now();
+    FILE* output = popen(command.c_str(), "r");
+    if (output == nullptr) {
+        Error::fatal("Could not run " + executable + ".");
+    }
+    std::vector<bench_clock::time_point> marks;
+    char buffer[4096];
+    std::string line;
+    while (fgets(buffer, sizeof(buffer), output) != nullptr) {
+        line += buffer;
+        if (line.back() != '\n') {
+            continue;
+        }
+        if (boost::starts_with(line, "Candidate ") || boost::starts_with(line, "Generated ")) {
+            marks.push_back(bench_clock::now());
+        }
+        line.clear();
+    }
+    int status = pclose(output);
+    result.seconds = milliseconds(start, bench_clock::now()) / 1000;
+    for (size_t i = 1; i < marks.size(); ++i) {
+        result.latencies.push_back(milliseconds(marks[i - 1], marks[i]));
+    }
+    if (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || result.latencies.size() != candidates) {
+        result.failures = static_cast<int>(candidates - std::min(candidates, result.latencies.size()));
+        result.failures = std::max(result.failures, 1);
+    }
+    return result;
+}
+
+static std::string json_string(const std::string& text)
+{
+    std::string escaped = boost::replace_all_copy(text, "\\", "\\\\");
+    boost::replace_all(escaped, "\"", "\\\"");
+    return "\"" + escaped + "\"";
+}
+
+int main(int argc, const char * argv[])
+{
+    Error::set_exec_name(boost::filesystem::path(argv[0]).filename().string());
+
+    boost::program_options::options_description desc("Options");
+    desc.add_options()
+        ("help,h", "this help message")
+        ("grammar,g", boost::program_options::value<std::string>(), "grammar xml file")
+        ("executable,e", boost::program_options::value<std::string>(), "grammar2code executable (default the one next to this program)")
+        ("depth,d", boost::program_options::value<int>()->default_value(3), "maximum depth of the recursions")
+        ("samples,n", boost::program_options::value<int>()->default_value(100), "configurations sampled and generated in each mode")
+        ("seed", boost::program_options::value<unsigned long>()->default_value(1), "seed of the sampled configurations")
+        ("modes", boost::program_options::value<std::string>()->default_value("cold,batch,parallel"), "execution modes, among 'cold', 'batch' and 'parallel'")
+        ("jobs,j", boost::program_options::value<int>()->default_value(std::max(1u, std::thread::hardware_concurrency())), "processes running at the same time in the parallel mode")
+        ("output,o", boost::program_options::value<std::string>()->default_value("throughput.json"), "file where the results are written as JSON")
+    ;
+    boost::program_options::positional_options_description positional;
+    positional.add("grammar", 1);
+    boost::program_options::variables_map vm;
+    boost::program_options::store(boost::program_options::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    boost::program_options::notify(vm);
+    if (vm.count("help") || vm.count("grammar") == 0) {
+        std::cout << "Measures the throughput and the latency of the code generation of grammar2code." << std::endl;
+        std::cout << "Usage: " << argv[0] << " grammar.xml [options]" << std::endl;
+        std::cout << desc << std::endl;
+        return vm.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::string grammar_xml = boost::filesystem::absolute(vm["grammar"].as<std::string>()).string();
+    std::string executable = vm.count("executable") != 0 ? vm["executable"].as<std::string>() :
+                             (boost::filesystem::path(argv[0]).parent_path() / "grammar2code").string();
+    executable = boost::filesystem::absolute(executable).string();
+    int depth = vm["depth"].as<int>();
+    int samples = vm["samples"].as<int>();
+    unsigned long seed = vm["seed"].as<unsigned long>();
+    int jobs = std::max(1, vm["jobs"].as<int>());
+    std::vector<std::string> modes;
+    boost::split(modes, vm["modes"].as<std::string>(), boost::is_any_of(","));
+
+    // the same configurations in all the modes
+    std::streambuf* cout_buffer = std::cout.rdbuf(nullptr);
+    std::streambuf* cerr_buffer = std::cerr.rdbuf(nullptr);
+    std::shared_ptr<grammar::model> ruleset = std::make_shared<grammar::model>(grammar_xml, boost::filesystem::path());
+    std::cout.rdbuf(cout_buffer);
+    std::cerr.rdbuf(cerr_buffer);
+    std::cout.clear();
+    std::cerr.clear();
+    grammar::sampler sampler(ruleset, depth, seed);
+    std::vector<std::vector<std::pair<std::string, std::string>>> configurations;
+    for (int i = 0; i < samples; ++i) {
+        configurations.push_back(sampler.sample());
+    }
+
+    boost::filesystem::path work_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("g2c_throughput_%%%%%%");
+    boost::filesystem::create_directories(work_dir);
+    boost::filesystem::path batch_file = work_dir / "candidates.txt";
+    std::ofstream batch(batch_file.string());
+    for (size_t i = 0; i < configurations.size(); ++i) {
+        batch << (i + 1);
+        for (auto& param : configurations[i]) {
+            batch << " --" << param.first << "=" << param.second;
+        }
+        batch << std::endl;
+    }
+    batch.close();
+
+    std::vector<mode_result> results;
+    for (auto& mode : modes) {
+        boost::filesystem::path target_dir = work_dir / mode;
+        if (mode == "cold") {
+            results.push_back(run_processes(mode, 1, executable, grammar_xml, target_dir, depth, configurations));
+        } else if (mode == "parallel") {
+            results.push_back(run_processes(mode, jobs, executable, grammar_xml, target_dir, depth, configurations));
+        } else if (mode == "batch") {
+            results.push_back(run_batch(executable, grammar_xml, target_dir, depth, batch_file, configurations.size()));
+        } else {
+            Error::fatal("Unknown mode " + mode + ".");
+        }
+        boost::filesystem::remove_all(target_dir);
+    }
+    boost::filesystem::remove_all(work_dir);
+
+    std::cout << std::left << std::setw(10) << "mode" << std::right << std::setw(11) << "processes";
+    std::cout << std::setw(14) << "candidates/s" << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms";
+    std::cout << std::setw(10) << "failures" << std::endl;
+    std::ofstream json(vm["output"].as<std::string>());
+    if (!json.good()) {
+        Error::fatal("Could not write " + vm["output"].as<std::string>() + ".");
+    }
+    json << "{" << std::endl;
+    json << "  \"grammar\": " << json_string(grammar_xml) << "," << std::endl;
+    json << "  \"executable\": " << json_string(executable) << "," << std::endl;
+    json << "  \"depth\": " << depth << "," << std::endl;
+    json << "  \"samples\": " << samples << "," << std::endl;
+    json << "  \"seed\": " << seed << "," << std::endl;
+    json << "  \"modes\": [" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const mode_result& result = results[i];
+        double throughput = result.seconds > 0 ? samples / result.seconds : 0;
+        double p50 = percentile(result.latencies, 0.50);
+        double p99 = percentile(result.latencies, 0.99);
+        std::cout << std::left << std::setw(10) << result.mode << std::right << std::setw(11) << result.processes;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(14) << throughput;
+        std::cout << std::setprecision(3) << std::setw(12) << p50 << std::setw(12) << p99;
+        std::cout << std::setw(10) << result.failures << std::endl;
+        json << "    {\"mode\": " << json_string(result.mode) << ", \"processes\": " << result.processes;
+        json << ", \"seconds\": " << result.seconds << ", \"candidates_per_second\": " << throughput;
+        json << ", \"p50_ms\": " << p50 << ", \"p99_ms\": " << p99 << ", \"failures\": " << result.failures << "}";
+        json << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    json << "  ]" << std::endl << "}" << std::endl;
+    json.close();
+    std::cout << std::endl << "Results written to " << vm["output"].as<std::string>() << "." << std::endl;
+
+    int failures = 0;
+    for (auto& result : results) {
+        failures += result.failures;
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,383 @@
+//
+//  basic_configuration.hpp
+//  grammar2code
+//
+//  Created by Franco Mascia on 26/07/13.
+//  Copyright (c) 2013 Franco Mascia. All rights reserved.
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+// members of grammar::basic_configuration, included only by the translation
+// units of the formats that instantiate it
+
+#ifndef __Grammar2Code__BasicConfiguration__
+#define __Grammar2Code__BasicConfiguration__
+
+#include "grammar.hpp"
+#include "error.hpp"
+#include "stats.hpp"
+#include "basic_walker.hpp"
+#include "workers.hpp"
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/erase.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/join.hpp>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// a copy of the format that walks an output root on its own, none for the
+// formats that cannot be copied
+template <class Format>
+static typename std::enable_if<std::is_copy_constructible<Format>::value, std::unique_ptr<Format>>::type
+root_copy(const Format& format)
+{
+    return std::unique_ptr<Format>(new Format(format));
+}
+
+template <class Format>
+static typename std::enable_if<!std::is_copy_constructible<Format>::value, std::unique_ptr<Format>>::type
+root_copy(const Format& format)
+{
+    return std::unique_ptr<Format>();
+}
+
+template <class Format>
+std::pair<std::string, std::string> grammar::basic_configuration<Format>::rule_name(const std::string& path)
+{
+    std::string command_name = path;
+    boost::erase_all(command_name, "@");
+    boost::erase_all(command_name, "%");
+    boost::erase_all(command_name, ":");
+    
+    std::string command_line = path;
+    boost::replace_all(command_line, ":", "-");
+    
+    return std::make_pair(command_name, command_line);
+}
+
+template <class Format>
+std::pair<std::string, std::string> grammar::basic_configuration<Format>::rule_cond(const std::string& path, const std::string& node_name, int rec_index)
+{
+    std::string condition = path;
+    std::string value;
+    
+    // recursive rule at depth0 or non recursive rule
+    bool standard_rule = true;
+    
+    // first check if this was a recursive rule and which depth, the count
+    // of a recursion depends on what its first level depends on
+    regex_ns::smatch m;
+    if (boost::ends_with(condition, "@reps")) {
+        boost::erase_last(condition, "@reps");
+    } else if (regex_ns::regex_search(condition, m, regex_ns::regex("@[0-9]+$"))) {
+        std::string x = *(m.begin());
+        boost::erase_last(condition, x);
+        boost::erase_first(x, "@");
+        int depth = std::stoi(x);
+        // the first level of a recursion nested in another one is deeper
+        // than 0, but has no previous level to depend on
+        if (this->recursion_level(path, depth) > 0) {
+            standard_rule = false;
+            condition = condition + "@" + std::to_string(depth - 1);
+            value = std::to_string(rec_index);
+        }
+    }
+    
+    // if the rule is non recursive or recursive at level 0 we continue
+    // stripping the last part to set the right condition
+    if (standard_rule) {
+        // remove node name and see what remains of path
+        boost::erase_last(condition, "%" + node_name);
+        if (regex_ns::regex_search(condition, m, regex_ns::regex("%[0-9]+$"))) {
+            // just one match
+            std::string x = *(m.begin());
+            boost::erase_last(condition, x);
+            boost::erase_first(x, "%");
+            value = x;
+        } else {
+            condition.clear();
+        }
+        // the alternatives of a recursion encoded by its count are active for
+        // the counts that reach their level
+        if (!value.empty() && regex_ns::regex_search(condition, m, regex_ns::regex("@([0-9]+)$"))) {
+            std::string parent = m.prefix().str();
+            auto it = recursion_counts_.find(parent);
+            if (it != recursion_counts_.end()) {
+                int level = std::stoi(m[1].str()) - it->second.start;
+                condition = parent + "@reps";
+                if (std::stoi(value) == it->second.recursive) {
+                    std::vector<std::string> counts;
+                    for (int i = level + 1; i < it->second.levels; ++i) {
+                        counts.push_back(std::to_string(i));
+                    }
+                    value = boost::join(counts, ", ");
+                } else {
+                    value = std::to_string(level);
+                }
+            }
+        }
+    }
+    // a folded parameter has a single value, so the condition on it is
+    // replaced by its own condition
+    for (auto folded = folded_.find(condition); !value.empty() && folded != folded_.end(); folded = folded_.find(condition)) {
+        condition = folded->second.first;
+        value = folded->second.second;
+    }
+    boost::trim(condition);
+    boost::trim(value);
+    return std::make_pair(condition, value);
+}
+
+template <class Format>
+bool grammar::basic_configuration<Format>::fold_degenerate(const std::string& path, const std::string& node_name, int rec_index)
+{
+    if (keep_degenerate_) {
+        return false;
+    }
+    folded_[path] = rule_cond(path, node_name, rec_index);
+    return true;
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::callback_call(const pugi::xml_node& node, const std::string& path, int depth)
+{
+}
+
+template <class Format>
+int grammar::basic_configuration<Format>::callback_categorical(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    std::string rule = format().fmt_rule_name(path);
+    stop_if_duplicate_parameters(rule);
+    std::string cond = format().fmt_rule_cond(path, node.name());
+    std::vector<std::string> choices;
+    int count = 0;
+    for (auto& child : node.children()) {
+        if (!strcmp(child.name(), "or")){
+            ++count;
+        }
+    }
+    for (int i = 0; i < count + 1; i++) {
+        choices.push_back(std::to_string(i));
+    }
+    format().fmt_parameter(rule, "categorical", choices, "", false, cond);
+    
+    return -1;
+}
+
+template <class Format>
+int grammar::basic_configuration<Format>::callback_recursive(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    int list_recursive = recursion_count_ ? this->list_recursion(node) : -1;
+    if (list_recursive != -1) {
+        std::string parent = path;
+        boost::erase_last(parent, "@" + std::to_string(depth));
+        auto it = recursion_counts_.find(parent);
+        if (it != recursion_counts_.end() && depth > it->second.start) {
+            // the following levels are encoded by the count of the first one
+            return -1;
+        }
+        recursion_count count{depth, std::max(1, this->remaining_levels(node, this->recursion_level(path, depth), depth)), list_recursive};
+        recursion_counts_[parent] = count;
+        std::string rule = format().fmt_rule_name(parent + "@reps");
+        stop_if_duplicate_parameters(rule);
+        std::vector<std::string> choices;
+        for (int i = 0; i < count.levels; ++i) {
+            choices.push_back(std::to_string(i));
+        }
+        if (count.levels == 1 && fold_degenerate(parent + "@reps", node.name())) {
+            return -1;
+        }
+        std::string cond = format().fmt_rule_cond(parent + "@reps", node.name(), list_recursive);
+        format().fmt_parameter(rule, "ordinal", choices, "0", false, cond);
+        return -1;
+    }
+
+    std::string rule = format().fmt_rule_name(path);
+    stop_if_duplicate_parameters(rule);
+    std::vector<std::string> choices;
+    auto enum_choices = this->get_choice(node.children());
+    int count = 0;
+    int rec_value = -1;
+    int levels = this->remaining_levels(node, this->recursion_level(path, depth), depth);
+    for (auto& choice : enum_choices) {
+        // check if this is the recursive rule
+        bool recursive = false;
+        for (auto& child : choice){
+            if (!strcmp(child.name(), node.name())) {
+                recursive = true;
+            }
+        }
+        if (recursive) {
+            if (levels > 1) {
+                choices.push_back(std::to_string(count));
+            }
+            rec_value = count;
+        }else{
+            choices.push_back(std::to_string(count));
+        }
+        ++count;
+    }
+    // only the base alternative is left at the last level
+    if (choices.size() == 1 && fold_degenerate(path, node.name(), rec_value)) {
+        return -1;
+    }
+    std::string cond = format().fmt_rule_cond(path, node.name(), rec_value);
+    format().fmt_parameter(rule, "categorical", choices, "", false, cond);
+    
+    return -1;
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::callback_range(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    std::string rule = format().fmt_rule_name(path);
+    stop_if_duplicate_parameters(rule);
+    std::string type = node.attribute("type").value();
+    if (type != "int" && type != "real") {
+        return;
+    }
+    if (this->fixed_range(node) && fold_degenerate(path, node.name())) {
+        return;
+    }
+    std::string cond = format().fmt_rule_cond(path, node.name());
+    std::vector<std::string> choices;
+    choices.push_back(node.attribute("min").value());
+    choices.push_back(node.attribute("max").value());
+    // default value
+    std::string default_value;
+    if (strcmp(node.attribute("default").value(), "")) {
+        default_value = node.attribute("default").value();
+    } else {
+        default_value = node.attribute("min").value();
+    }
+    // log scale sampling
+    std::string attribute = node.attribute("log-scale").value();
+    bool log_scale = false;
+    if (boost::iequals(attribute, "true") || boost::iequals(attribute, "yes")) {
+        log_scale = true;
+    }
+
+    format().fmt_parameter(rule, type, choices, default_value, log_scale, cond);
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::callback_copy(const pugi::xml_node& node, const std::string& path, int depth)
+{
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::callback_cdata(const pugi::xml_node& node, const std::string& path, int depth)
+{
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::callback_plain(const pugi::xml_node& node, const std::string& path, int depth)
+{
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::print(std::ostream& stream)
+{
+    generate();
+    write(stream);
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::write(std::ostream& stream)
+{
+    for (auto& parameter : parameters_) {
+        stream << parameter << std::endl;
+    }
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::begin()
+{
+    format().reset();
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::consume(const walk_cursor::event& event)
+{
+    this->handle(event);
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::end()
+{
+    Stats::count("parameters_emitted", parameters_.size());
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::generate()
+{
+    begin();
+    const grammar::ir& ir = this->model_->lowered();
+    std::vector<pugi::xml_node> roots;
+    for (auto root : ir.roots()) {
+        roots.push_back(ir.at(root).xml);
+    }
+    if (std::is_copy_constructible<Format>::value && Workers::jobs() > 1 && roots.size() > 1 && this->independent_roots(roots)) {
+        // each root is walked by a copy of the format, and the parameters
+        // are merged in the order of the roots
+        std::vector<std::unique_ptr<Format>> workers(roots.size());
+        Workers::run(roots.size(), [&](size_t i) {
+            workers[i] = root_copy(format());
+            workers[i]->walk(roots[i]);
+        });
+        for (auto& worker : workers) {
+            format().merge(*worker);
+        }
+    } else {
+        this->walk();
+    }
+    end();
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::reset()
+{
+    parameters_.clear();
+    parameter_names_.clear();
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::merge(Format& worker)
+{
+    basic_configuration& other = worker;
+    for (auto& name : other.parameter_names_) {
+        stop_if_duplicate_parameters(name);
+    }
+    parameters_.insert(parameters_.end(), other.parameters_.begin(), other.parameters_.end());
+    folded_.insert(other.folded_.begin(), other.folded_.end());
+    recursion_counts_.insert(other.recursion_counts_.begin(), other.recursion_counts_.end());
+}
+
+template <class Format>
+void grammar::basic_configuration<Format>::stop_if_duplicate_parameters(std::string parameter) {
+    // there can be rare cases in which parameters have the same name, in this
+    // case we stop and return a message to the user to solve the name clash
+    // manually
+    //
+    // for example A221 could be choice 1 at the second level of recursion of
+    // parameter A2 or choice 1 of parameter A22 (this could happen also because
+    // of the duplication of rule calls at the end of simplification rules
+    if (std::find(parameter_names_.begin(), parameter_names_.end(), parameter) != parameter_names_.end()) {
+        for (auto& parameter : parameters_) {
+            std::cerr << parameter << std::endl;
+        }
+        Error::fatal(parameter);
+    } else {
+        parameter_names_.push_back(parameter);
+    }
+}
+
+#endif /* defined(__Grammar2Code__BasicConfiguration__) */
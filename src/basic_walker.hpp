@@ -0,0 +1,84 @@
+//
+//  basic_walker.hpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+// members of grammar::basic_walker, included only by the translation units
+// that instantiate it, next to the callbacks of the walker
+
+#ifndef __Grammar2Code__BasicWalker__
+#define __Grammar2Code__BasicWalker__
+
+#include "grammar.hpp"
+#include "walk_cursor.hpp"
+
+template <class Derived>
+void grammar::basic_walker<Derived>::walk()
+{
+    cursor_.set_max_depth(max_depth_);
+    cursor_.start();
+    dispatch();
+}
+
+template <class Derived>
+void grammar::basic_walker<Derived>::walk(const pugi::xml_node& root)
+{
+    cursor_.set_max_depth(max_depth_);
+    cursor_.start(root);
+    dispatch();
+}
+
+template <class Derived>
+void grammar::basic_walker<Derived>::dispatch()
+{
+    while (cursor_.next()) {
+        // a callback can start a walk of its own, which replaces the event
+        bool choice = cursor_.current().type == walk_cursor::event::choice;
+        int alternative = handle(cursor_.current());
+        if (choice) {
+            cursor_.select(alternative);
+        }
+    }
+}
+
+template <class Derived>
+int grammar::basic_walker<Derived>::handle(const walk_cursor::event& current)
+{
+    typedef grammar::walk_cursor::event event;
+    switch (current.type) {
+        case event::call:
+            derived().callback_call(current.node, current.path, current.depth);
+            break;
+        case event::choice:
+            if (current.recursive) {
+                return derived().callback_recursive(current.node, current.path, current.depth);
+            }
+            return derived().callback_categorical(current.node, current.path, current.depth);
+        case event::begin_alternative:
+            derived().callback_alternative(current.node, current.path, current.depth, current.alternative);
+            break;
+        case event::end_choice:
+            derived().callback_end_choice(current.node, current.path, current.depth);
+            break;
+        case event::range:
+            derived().callback_range(current.node, current.path, current.depth);
+            break;
+        case event::copy:
+            derived().callback_copy(current.node, current.path, current.depth);
+            break;
+        case event::cdata:
+            derived().callback_cdata(current.node, current.path, current.depth);
+            break;
+        case event::plain:
+            derived().callback_plain(current.node, current.path, current.depth);
+            break;
+        case event::output:
+            break;
+    }
+    return -1;
+}
+
+#endif /* defined(__Grammar2Code__BasicWalker__) */
@@ -0,0 +1,181 @@
+//
+//  build_graph.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#define UNITY_NAME "g2c_unity"
+
+static bool is_c_source(const boost::filesystem::path& file)
+{
+    return file.extension() == ".c";
+}
+
+static bool is_cpp_source(const boost::filesystem::path& file)
+{
+    std::string extension = file.extension().string();
+    return extension == ".cpp" || extension == ".cc" || extension == ".cxx" || extension == ".C";
+}
+
+static std::string ninja_escape(std::string path)
+{
+    boost::replace_all(path, "$", "$$");
+    boost::replace_all(path, " ", "$ ");
+    boost::replace_all(path, ":", "$:");
+    return path;
+}
+
+// path of target relative to base if base is one of its prefixes, otherwise
+// the absolute path of target
+static boost::filesystem::path relative_to(const boost::filesystem::path& target, const boost::filesystem::path& base)
+{
+    boost::filesystem::path abs_target = boost::filesystem::absolute(target);
+    boost::filesystem::path abs_base = boost::filesystem::absolute(base);
+    auto it_target = abs_target.begin();
+    for (auto it_base = abs_base.begin(); it_base != abs_base.end(); ++it_base, ++it_target) {
+        if (it_target == abs_target.end() || *it_target != *it_base) {
+            return abs_target;
+        }
+    }
+    boost::filesystem::path relative;
+    for (; it_target != abs_target.end(); ++it_target) {
+        relative /= *it_target;
+    }
+    return relative;
+}
+
+grammar::build_graph::build_graph(std::string compiler, std::string compiler_flags, std::string linker_flags, std::string executable) : compiler_(compiler), compiler_flags_(compiler_flags), linker_flags_(linker_flags), executable_(executable)
+{
+}
+
+void grammar::build_graph::write_rules(std::ostream& stream, const std::string& compiler, const std::string& include_dir)
+{
+    stream << "# This file has been generated by grammar2code." << std::endl;
+    stream << "cc = " << compiler << std::endl;
+    stream << "cflags = " << compiler_flags_ << std::endl;
+    stream << "ldflags = " << linker_flags_ << std::endl;
+    stream << "dir = " << include_dir << std::endl << std::endl;
+    stream << "rule cc" << std::endl;
+    stream << "  command = $cc $cflags -I$dir -MMD -MF $out.d -c $in -o $out" << std::endl;
+    stream << "  depfile = $out.d" << std::endl;
+    stream << "  deps = gcc" << std::endl;
+    stream << "  description = CC $out" << std::endl << std::endl;
+    stream << "rule link" << std::endl;
+    // after the objects, so that the libraries resolve their symbols
+    stream << "  command = $cc $cflags $in -o $out $ldflags" << std::endl;
+    stream << "  description = LINK $out" << std::endl << std::endl;
+}
+
+void grammar::build_graph::add_candidate(const boost::filesystem::path& target_dir, const std::vector<boost::filesystem::path>& files)
+{
+    // sorting the files makes both the unity source and the object independent
+    // from the order in which they have been generated
+    std::vector<boost::filesystem::path> sorted(files);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    bool cpp = false;
+    std::vector<boost::filesystem::path> sources;
+    std::string content;
+    for (auto& file : sorted) {
+        if (is_c_source(file) || is_cpp_source(file)) {
+            sources.push_back(file);
+            cpp = cpp || is_cpp_source(file);
+        }
+        std::ifstream fin((target_dir / file).string());
+        std::ostringstream buffer;
+        buffer << fin.rdbuf();
+        content += file.generic_string() + '\0' + buffer.str() + '\0';
+    }
+    if (sources.empty()) {
+        Error::warning("No source files to build in " + target_dir.string() + ".");
+        return;
+    }
+
+    candidate current;
+    current.dir = target_dir;
+    current.unity = std::string(UNITY_NAME) + (cpp ? ".cpp" : ".c");
+    current.compiler = compiler_.empty() ? (cpp ? "c++" : "cc") : compiler_;
+    // the key is the whole content, so that two candidates share an object
+    // only if their files are actually the same
+    auto object = objects_.emplace(current.compiler + '\0' + content, objects_.size()).first;
+    current.object = std::to_string(object->second);
+
+    // unity translation unit
+    std::ofstream unity((target_dir / current.unity).string());
+    if (!unity.good()) {
+        Error::fatal("Could not write " + (target_dir / current.unity).string() + ".");
+    }
+    unity << "// This file has been generated by grammar2code, it includes all the" << std::endl;
+    unity << "// sources of the candidate to compile them as a single translation unit." << std::endl;
+    for (auto& source : sources) {
+        unity << "#include \"" << source.generic_string() << "\"" << std::endl;
+    }
+    unity.close();
+
+    // build file of the single candidate, to be run with ninja -C target_dir
+    std::ofstream ninja((target_dir / "build.ninja").string());
+    if (!ninja.good()) {
+        Error::fatal("Could not write " + (target_dir / "build.ninja").string() + ".");
+    }
+    write_rules(ninja, current.compiler, ".");
+    ninja << "build " << UNITY_NAME << ".o: cc " << current.unity << std::endl;
+    ninja << "build " << ninja_escape(executable_) << ": link " << UNITY_NAME << ".o" << std::endl;
+    ninja << "default " << ninja_escape(executable_) << std::endl;
+    ninja.close();
+
+    candidates_.push_back(current);
+}
+
+void grammar::build_graph::write_batch(const boost::filesystem::path& batch_dir)
+{
+    if (candidates_.empty()) {
+        return;
+    }
+    std::ofstream ninja((batch_dir / "build.ninja").string());
+    if (!ninja.good()) {
+        Error::fatal("Could not write " + (batch_dir / "build.ninja").string() + ".");
+    }
+    write_rules(ninja, candidates_.front().compiler, ".");
+
+    // candidates with the same files share the same object, which is then
+    // compiled only once
+    std::unordered_set<std::string> objects;
+    std::vector<std::string> executables;
+    for (auto& current : candidates_) {
+        std::string dir = ninja_escape(relative_to(current.dir, batch_dir).generic_string());
+        std::string object = "objs/" + current.object + ".o";
+        if (objects.insert(object).second) {
+            ninja << "build " << object << ": cc " << dir << "/" << current.unity << std::endl;
+            ninja << "  cc = " << current.compiler << std::endl;
+            ninja << "  dir = " << dir << std::endl;
+        }
+        std::string executable = dir + "/" + ninja_escape(executable_);
+        ninja << "build " << executable << ": link " << object << std::endl;
+        ninja << "  cc = " << current.compiler << std::endl;
+        executables.push_back(executable);
+    }
+    ninja << std::endl << "build all: phony";
+    for (auto& executable : executables) {
+        ninja << " " << executable;
+    }
+    ninja << std::endl << "default all" << std::endl;
+    ninja.close();
+
+    std::cout << "Build graph for " << candidates_.size() << " candidates (" << objects.size();
+    std::cout << " distinct objects) written to " << (batch_dir / "build.ninja") << "." << std::endl;
+}
@@ -12,8 +12,11 @@
 //
 
 #include "grammar.hpp"
+#include "basic_configuration.hpp"
 
 #include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
 
 
 #include <string>
@@ -33,7 +36,13 @@ std::string grammar::crace_conf::fmt_rule_cond(const std::string& path, const st
     if (cond.first.empty() || cond.second.empty()) {
         return "";
     } else {
-        return "\t| " + cond_name.first + " == " + cond.second;
+        // conditions on counts of recursions can have several values
+        std::vector<std::string> values;
+        boost::split(values, cond.second, boost::is_any_of(", "), boost::token_compress_on);
+        for (auto& value : values) {
+            value = cond_name.first + " == " + value;
+        }
+        return "\t| " + boost::join(values, " || ");
     }
 }
 
@@ -48,8 +57,13 @@ void grammar::crace_conf::fmt_parameter(const std::string& rule_name, const std:
         type = "c";
     } else if (rule_type == "recursive") {
         type = "c";
+    } else if (rule_type == "ordinal") {
+        type = "o";
     }
 
     std::string alternatives = boost::join(values, ", ");
     parameters_.push_back(rule_name + " " + type + " (" + alternatives + ")" + rule_cond);
 }
+
+template class grammar::basic_walker<grammar::crace_conf>;
+template class grammar::basic_configuration<grammar::crace_conf>;
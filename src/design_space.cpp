@@ -0,0 +1,167 @@
+//
+//  design_space.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+
+#include <boost/algorithm/string/erase.hpp>
+#include <boost/algorithm/string/replace.hpp>
+
+#include <string>
+#include <vector>
+
+grammar::design_space::design_space(std::shared_ptr<grammar::model>& a_model, int max_depth) : walker_base(a_model, max_depth)
+{
+}
+
+const std::vector<pugi::xml_node>& grammar::design_space::definitions(const pugi::xml_node& node)
+{
+    std::string name = node.name();
+    auto it = definitions_.find(name);
+    if (it == definitions_.end()) {
+        std::vector<pugi::xml_node> nodes;
+        const grammar::ir& ir = model_->lowered();
+        grammar::ir::slice rule = ir.definitions(name);
+        for (unsigned i = 0; i < rule.size; ++i) {
+            nodes.push_back(ir.at(ir.definition_at(rule.first + i)).xml);
+        }
+        if (nodes.empty()) {
+            Error::fatal("No definition for " + name + ".");
+        }
+        it = definitions_.insert(std::make_pair(name, nodes)).first;
+    }
+    return it->second;
+}
+
+std::vector<boost::multiprecision::cpp_int> grammar::design_space::alternative_counts(const pugi::xml_node& node, int depth, int level)
+{
+    // same depths of walker::do_walk, the alternatives of a recursive node
+    // are walked one level deeper, and its self-calls continue its recursion
+    bool recursive = type(node) == grammar::walker_base::node_type::recursive;
+    int child_depth = recursive ? depth + 1 : depth;
+    std::vector<boost::multiprecision::cpp_int> counts;
+    for (auto& choice : get_choice(node.children())) {
+        boost::multiprecision::cpp_int alternative = 1;
+        if (recursive && remaining_levels(node, level, depth) <= 1) {
+            for (auto& child : choice) {
+                if (!strcmp(child.name(), node.name())) {
+                    alternative = 0;
+                }
+            }
+        }
+        for (auto& child : choice) {
+            if (alternative == 0) {
+                break;
+            }
+            bool self_call = recursive && !strcmp(child.name(), node.name());
+            alternative *= count(child, child_depth, self_call ? level + 1 : 0);
+        }
+        counts.push_back(alternative);
+    }
+    return counts;
+}
+
+void grammar::design_space::begin_assignment()
+{
+    recursion_counts_.clear();
+}
+
+void grammar::design_space::assign(std::vector<std::pair<std::string, std::string>>& assignment, const pugi::xml_node& node,
+                                   const std::string& path, int depth, int choice)
+{
+    std::string name = path;
+    boost::replace_all(name, ":", "-");
+    if (type(node) == grammar::walker_base::node_type::recursive) {
+        int level = recursion_level(path, depth);
+        int recursive = recursion_count_ ? list_recursion(node) : -1;
+        if (recursive != -1) {
+            // the levels are chosen one by one, but only their count is
+            // assigned, to the parameter of the first level
+            std::string parent = name;
+            boost::erase_last(parent, "@" + std::to_string(depth));
+            auto count = recursion_counts_.find(parent);
+            if (count == recursion_counts_.end() || depth <= count->second.first) {
+                int index = -1;
+                if (std::max(1, remaining_levels(node, level, depth)) > 1 || keep_degenerate_) {
+                    index = static_cast<int>(assignment.size());
+                    assignment.push_back(std::make_pair(parent + "@reps", "0"));
+                }
+                recursion_counts_[parent] = std::make_pair(depth, index);
+                count = recursion_counts_.find(parent);
+            }
+            if (choice == recursive && count->second.second != -1) {
+                std::string& reps = assignment[count->second.second].second;
+                reps = std::to_string(std::stoi(reps) + 1);
+            }
+            return;
+        }
+        // folded in the configurations, only the base alternative is left
+        if (!keep_degenerate_ && base_alternative(node) != -1 && remaining_levels(node, level, depth) <= 1) {
+            return;
+        }
+    }
+    assignment.push_back(std::make_pair(name, std::to_string(choice)));
+}
+
+bool grammar::design_space::assigned(const pugi::xml_node& range) const
+{
+    return keep_degenerate_ || !fixed_range(range);
+}
+
+boost::multiprecision::cpp_int grammar::design_space::count(const pugi::xml_node& node, int depth, int level)
+{
+    auto key = std::make_tuple(node.internal_object(), depth, level);
+    auto memo = counts_.find(key);
+    if (memo != counts_.end()) {
+        return memo->second;
+    }
+
+    boost::multiprecision::cpp_int result = 1;
+    switch (type(node)) {
+        case grammar::walker_base::node_type::call:
+            for (auto& definition : definitions(node)) {
+                result *= count(definition, depth, level);
+            }
+            break;
+        case grammar::walker_base::node_type::categorical:
+        case grammar::walker_base::node_type::recursive:
+            result = 0;
+            for (auto& alternative : alternative_counts(node, depth, level)) {
+                result += alternative;
+            }
+            break;
+        case grammar::walker_base::node_type::plain:
+            for (auto& child : node.children()) {
+                if (strcmp(child.name(), "or")) {
+                    result *= count(child, depth, 0);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    counts_[key] = result;
+    return result;
+}
+
+boost::multiprecision::cpp_int grammar::design_space::count()
+{
+    boost::multiprecision::cpp_int total = 1;
+    for (auto& root : output_roots()) {
+        total *= count(root, 0, 0);
+    }
+    return total;
+}
+
+void grammar::design_space::print(std::ostream& stream)
+{
+    for (auto& root : output_roots()) {
+        stream << root.name() << " (" << root.attribute("output").value() << "): " << count(root, 0, 0) << std::endl;
+    }
+    stream << "total: " << count() << std::endl;
+}
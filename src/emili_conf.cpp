@@ -8,7 +8,9 @@
 
 
 #include "grammar.hpp"
+#include "basic_configuration.hpp"
 #include "error.hpp"
+#include "stats.hpp"
 #include "emili_constants.h"
 
 #include <boost/algorithm/string/join.hpp>
@@ -22,11 +24,37 @@
 #include <sstream>
 
 void grammar::emili_conf::print(std::ostream& stream)
+{
+    build();
+    write(stream);
+}
+
+void grammar::emili_conf::write(std::ostream& stream)
+{
+    for (auto& header : header_)
+    {
+        stream << header << std::endl;
+    }
+    for (auto& parameter : parameters_) {
+        stream << parameter << std::endl;
+    }
+}
+
+void grammar::emili_conf::consume(const walk_cursor::event& event)
+{
+}
+
+void grammar::emili_conf::end()
+{
+    build();
+}
+
+void grammar::emili_conf::build()
 {
     parameters_.clear();
     header_.clear();
     pugi::xpath_query output_file("/gr:grammar/gr:derivations/*[@output]");
-    for(auto& el : output_file.evaluate_node_set(model_->grammar()))
+    for(auto& el : Stats::xpath(output_file).evaluate_node_set(model_->grammar()))
     {
         const pugi::xml_node& node = el.node();
         const pugi::xml_attribute& outfile = node.attribute("output");
@@ -93,14 +121,6 @@ void grammar::emili_conf::print(std::ostream& stream)
     writeShakeCode();
     writeNeighborhoodChangeCode();
     endClass();
-    
-    for (auto& header : header_)
-    {
-        stream << header << std::endl;
-    }
-    for (auto& parameter : parameters_) {
-        stream << parameter << std::endl;
-    }
 }
 
 std::string grammar::emili_conf::fmt_rule_name(const std::string& path)
@@ -132,6 +152,8 @@ void grammar::emili_conf::fmt_parameter(const std::string& rule_name, const std:
         type = "c";
     } else if (rule_type == "recursive") {
         type = "c";
+    } else if (rule_type == "ordinal") {
+        type = "o";
     }
     
     std::string alternatives = boost::join(values, ", ");
@@ -145,7 +167,7 @@ void grammar::emili_conf::writeParametersCode(const char* parameter_name, int pa
     pugi::xpath_query parameter(parameter_query.c_str());
     std::ostringstream oss;
     int found = 0;
-    for (auto& element : parameter.evaluate_node_set(model_->grammar()))
+    for (auto& element : Stats::xpath(parameter).evaluate_node_set(model_->grammar()))
     {
         const pugi::xml_node& par = element.node();
         const pugi::xml_attribute& att = par.attribute("type");
@@ -224,7 +246,7 @@ void grammar::emili_conf::writeComponentsCode(pugi::xpath_query& component)
     std::ostringstream oss;
     int index = 0;
     parameters_.push_back("  prs::incrementTabLevel();\n  std::ostringstream oss;");
-    for (auto& element : component.evaluate_node_set(model_->grammar())) {
+    for (auto& element : Stats::xpath(component).evaluate_node_set(model_->grammar())) {
         //do_walk(element.node(), "", 0);
         oss.str("");
         const pugi::xml_node& node = element.node();
@@ -443,3 +465,6 @@ void grammar::emili_conf::printToFile(const std::string& filename)
     }
     cpp_file.close();
 }
+
+template class grammar::basic_walker<grammar::emili_conf>;
+template class grammar::basic_configuration<grammar::emili_conf>;
@@ -0,0 +1,36 @@
+//
+//  emitter.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "walk_cursor.hpp"
+
+grammar::emitter::emitter(std::shared_ptr<grammar::model>& a_model, int max_depth) : cursor_(a_model, max_depth)
+{
+}
+
+void grammar::emitter::add(std::shared_ptr<configuration> format)
+{
+    formats_.push_back(format);
+}
+
+void grammar::emitter::walk()
+{
+    for (auto& format : formats_) {
+        format->begin();
+    }
+    // no alternative is selected, the formats walk all of them
+    cursor_.start();
+    while (cursor_.next()) {
+        for (auto& format : formats_) {
+            format->consume(cursor_.current());
+        }
+    }
+    for (auto& format : formats_) {
+        format->end();
+    }
+}
@@ -0,0 +1,124 @@
+//
+//  enumerator.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+#include "basic_walker.hpp"
+
+#include <boost/algorithm/string/replace.hpp>
+
+#include <string>
+#include <vector>
+
+grammar::enumerator::enumerator(std::shared_ptr<grammar::model>& a_model, int max_depth) : basic_walker(a_model, max_depth), space_(a_model, max_depth), cursor_(0)
+{
+    total_ = space_.count();
+    end_ = total_;
+}
+
+const boost::multiprecision::cpp_int& grammar::enumerator::count() const
+{
+    return total_;
+}
+
+void grammar::enumerator::set_range(const boost::multiprecision::cpp_int& begin, const boost::multiprecision::cpp_int& end)
+{
+    cursor_ = begin;
+    end_ = std::min(end, total_);
+}
+
+const boost::multiprecision::cpp_int& grammar::enumerator::cursor() const
+{
+    return cursor_;
+}
+
+const std::vector<std::pair<std::string, std::string>>& grammar::enumerator::assignment() const
+{
+    return assignment_;
+}
+
+bool grammar::enumerator::next()
+{
+    if (cursor_ >= end_) {
+        return false;
+    }
+    assignment_.clear();
+    space_.begin_assignment();
+    frames_.clear();
+    frame root;
+    root.index = cursor_;
+    root.divisor = total_;
+    frames_.push_back(root);
+    walk();
+    ++cursor_;
+    return true;
+}
+
+int grammar::enumerator::choose(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    // the choices are the digits of the index of the alternative in the
+    // order they are walked, the first being the most significant one
+    frame& current = frames_.back();
+    int level = type(node) == grammar::walker_base::node_type::recursive ? recursion_level(path, depth) : 0;
+    current.divisor /= space_.count(node, depth, level);
+    boost::multiprecision::cpp_int index = current.index / current.divisor;
+    current.index %= current.divisor;
+
+    int choice = 0;
+    for (auto& alternative : space_.alternative_counts(node, depth, level)) {
+        if (index < alternative) {
+            frame next;
+            next.index = index;
+            next.divisor = alternative;
+            frames_.push_back(next);
+            break;
+        }
+        index -= alternative;
+        ++choice;
+    }
+
+    space_.assign(assignment_, node, path, depth, choice);
+    return choice;
+}
+
+int grammar::enumerator::callback_categorical(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    return choose(node, path, depth);
+}
+
+int grammar::enumerator::callback_recursive(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    return choose(node, path, depth);
+}
+
+void grammar::enumerator::callback_end_choice(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    frames_.pop_back();
+}
+
+void grammar::enumerator::callback_range(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    std::string type = node.attribute("type").value();
+    if (type != "int" && type != "real") {
+        return;
+    }
+    if (!space_.assigned(node)) {
+        return;
+    }
+    std::string default_value;
+    if (strcmp(node.attribute("default").value(), "")) {
+        default_value = node.attribute("default").value();
+    } else {
+        default_value = node.attribute("min").value();
+    }
+    std::string name = path;
+    boost::replace_all(name, ":", "-");
+    assignment_.push_back(std::make_pair(name, default_value));
+}
+
+template class grammar::basic_walker<grammar::enumerator>;
@@ -13,16 +13,33 @@
 
 #include <iostream>
 #include <cstdlib>
+#include <mutex>
 
 std::string Error::executable_name = "";
 
+// a single thread reports its error and ends the program
+static std::mutex fatal_mutex;
+
+static thread_local bool deferred_errors = false;
+
 void Error::set_exec_name(const std::string& name)
 {
     executable_name = name;
 }
 
+bool Error::defer(bool deferred)
+{
+    bool previous = deferred_errors;
+    deferred_errors = deferred;
+    return previous;
+}
+
 void Error::fatal(std::string message)
 {
+    if (deferred_errors) {
+        throw failure{message};
+    }
+    fatal_mutex.lock();
     std::cerr << std::endl << "Error";
     if (!executable_name.empty()) {
         std::cerr << " (" << executable_name << ")";
@@ -16,10 +16,21 @@
 
 class Error {
 public:
+    // thrown by fatal instead of ending the program while the errors of the
+    // calling thread are deferred
+    struct failure {
+        std::string message;
+    };
+
     static void set_exec_name(const std::string& name);
     static void fatal(std::string message);
     static void warning(std::string message);
 
+    // sets whether the errors of the calling thread are deferred, so that a
+    // pool of threads can stop its workers before reporting them (see
+    // Workers::run), and returns the previous setting
+    static bool defer(bool deferred);
+
 private:
     static std::string executable_name;
 };
@@ -0,0 +1,456 @@
+//
+//  generator_compiler.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+#include "stats.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/version.hpp>
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if (BOOST_VERSION / 100000) < 1 || ((BOOST_VERSION / 100) % 1000) < 48
+#define normalise_path(path_s)(boost::filesystem::absolute(path_s))
+#else
+#define normalise_path(path_s)(boost::filesystem::canonical(path_s))
+#endif
+
+// the part of the generator that does not depend on the grammar, it mirrors
+// what params2code does when generating the code
+static const char *generator_runtime = R"(
+static std::unordered_map<std::string, std::string> parameters;
+static std::filesystem::path target_dir;
+static bool do_not_reindent = false;
+// --depth of the configurations, which tells the levels folded in them
+static int max_depth = 3;
+static std::vector<std::string> code;
+static std::ofstream fout;
+
+[[noreturn]] static void fatal(const std::string &message)
+{
+    std::cerr << std::endl << "Error: " << message << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// the fallback is the value of the parameters folded in the configurations
+[[maybe_unused]] static std::string take(std::string path, const char *fallback = nullptr)
+{
+    std::replace(path.begin(), path.end(), ':', '-');
+    auto it = parameters.find(path);
+    if (it == parameters.end()) {
+        if (fallback) {
+            return fallback;
+        }
+        fatal("No parameter to translate '" + path + "'.");
+    }
+    std::string value = it->second;
+    parameters.erase(it);
+    return value;
+}
+
+[[maybe_unused]] static int take_choice(const std::string &path, const char *fallback = nullptr)
+{
+    return std::stoi(take(path, fallback));
+}
+
+// same as params2code::recursion_count_choice: path@reps replaces all the
+// levels of a list-like recursion, -1 if there is no such parameter
+[[maybe_unused]] static int recursion_count_choice(std::string parent, int depth, int recursive)
+{
+    static std::unordered_map<std::string, std::pair<int, int>> counts;
+    std::replace(parent.begin(), parent.end(), ':', '-');
+    auto count = counts.find(parent);
+    if (count == counts.end() || depth <= count->second.first) {
+        auto it = parameters.find(parent + "@reps");
+        if (it == parameters.end()) {
+            return -1;
+        }
+        counts[parent] = std::make_pair(depth, std::stoi(it->second));
+        count = counts.find(parent);
+        parameters.erase(it);
+    }
+    return depth - count->second.first < count->second.second ? recursive : 1 - recursive;
+}
+
+// the choice of a level of a list-like recursion, given by its own parameter
+// or by the count of the recursion
+[[maybe_unused]] static int take_level(const std::string &path, const std::string &parent, int depth, int recursive, const char *fallback)
+{
+    std::string name = path;
+    std::replace(name.begin(), name.end(), ':', '-');
+    if (parameters.count(name) == 0) {
+        int choice = recursion_count_choice(parent, depth, recursive);
+        if (choice != -1) {
+            return choice;
+        }
+    }
+    return take_choice(path, fallback);
+}
+
+[[maybe_unused]] static std::string erase_last(std::string path, const std::string &suffix)
+{
+    size_t pos = path.rfind(suffix);
+    if (pos != std::string::npos) {
+        path.erase(pos, suffix.size());
+    }
+    return path;
+}
+
+// same as walker_base::recursion_level
+[[maybe_unused]] static int recursion_level(const std::string &path, int depth)
+{
+    std::string parent = path.substr(0, path.rfind('@'));
+    size_t at = parent.rfind('@');
+    if (at == std::string::npos) {
+        return depth;
+    }
+    return depth - std::atoi(parent.c_str() + at + 1) - 1;
+}
+
+static void close_file()
+{
+    if (!code.empty()) {
+        std::string all;
+        for (auto &block : code) {
+            all += block;
+        }
+        std::vector<std::string> lines;
+        size_t begin = 0;
+        while (true) {
+            size_t end = all.find_first_of("\n\r", begin);
+            lines.push_back(all.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+            if (end == std::string::npos) {
+                break;
+            }
+            begin = end + 1;
+        }
+        auto blank = [](const std::string &line) {
+            return line.find_first_not_of(" \t\r\n\f\v") == std::string::npos;
+        };
+        while (!lines.empty() && blank(lines.back())) {
+            lines.pop_back();
+        }
+        size_t indentation = 0;
+        if (!do_not_reindent) {
+            indentation = std::string::npos;
+            for (auto &line : lines) {
+                size_t len = line.find_first_not_of(" \t\r\n");
+                if (len != std::string::npos && len < indentation) {
+                    indentation = len;
+                }
+            }
+            if (indentation == std::string::npos) {
+                indentation = 0;
+            }
+        }
+        for (auto &line : lines) {
+            if (!blank(line)) {
+                fout << line.substr(indentation);
+            }
+            fout << std::endl;
+        }
+        fout << std::endl;
+        code.clear();
+    }
+    if (fout.is_open()) {
+        fout.close();
+    }
+}
+
+static void output_file(const std::string &name)
+{
+    close_file();
+    std::filesystem::path output = std::filesystem::absolute(target_dir / name);
+    std::filesystem::create_directories(output.parent_path());
+    std::cout << "Output file " << output << std::endl;
+    fout.open(output);
+    if (!fout.good()) {
+        fatal("Could not write " + name + ".");
+    }
+}
+
+[[maybe_unused]] static void copy_single_file(const std::filesystem::path &source, const std::filesystem::path &destination)
+{
+    std::filesystem::path dst = std::filesystem::absolute(target_dir / destination);
+    std::filesystem::create_directories(dst.parent_path());
+    std::cout << "Copying " << source << " to " << dst << std::endl;
+    std::filesystem::copy_file(source, dst, std::filesystem::copy_options::overwrite_existing);
+}
+
+[[maybe_unused]] static void copy_filtered_files(const std::filesystem::path &source_dir, const std::filesystem::path &destination_dir,
+                                                  const std::string &filter)
+{
+    std::regex files_filter(filter);
+    for (auto &entry : std::filesystem::directory_iterator(source_dir)) {
+        std::string filename = entry.path().filename().string();
+        if (entry.is_regular_file() && std::regex_search(filename, files_filter)) {
+            copy_single_file(entry.path(), destination_dir / filename);
+        }
+    }
+}
+
+static void parse_parameters(int argc, const char *argv[])
+{
+    // same clean up of the spaces around the equal symbols done by grammar2code
+    std::string line;
+    for (int i = 1; i < argc; ++i) {
+        line += std::string(i > 1 ? " " : "") + argv[i];
+    }
+    for (auto pattern : {" =", "= "}) {
+        size_t pos;
+        while ((pos = line.find(pattern)) != std::string::npos) {
+            line.replace(pos, 2, "=");
+        }
+    }
+    std::istringstream tokens(line);
+    std::vector<std::string> args;
+    for (std::string token; tokens >> token; ) {
+        args.push_back(token);
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+        std::string arg = args[i];
+        if (arg == "-t" && i + 1 < args.size()) {
+            target_dir = args[++i];
+        } else if (arg.compare(0, 13, "--target_dir=") == 0) {
+            target_dir = arg.substr(13);
+        } else if (arg == "-x" || arg == "--do_not_reindent") {
+            do_not_reindent = true;
+        } else if ((arg == "-d" || arg == "--depth") && i + 1 < args.size()) {
+            max_depth = std::stoi(args[++i]);
+        } else if (arg.compare(0, 8, "--depth=") == 0) {
+            max_depth = std::stoi(arg.substr(8));
+        } else if (arg.compare(0, 2, "--") == 0 && arg.find('=') != std::string::npos) {
+            size_t equal = arg.find('=');
+            parameters[arg.substr(2, equal - 2)] = arg.substr(equal + 1);
+        } else if (arg.compare(0, 1, "-") == 0 && i + 1 < args.size()) {
+            parameters[arg.substr(1)] = args[++i];
+        } else {
+            fatal("Cannot parse parameter " + arg + ".");
+        }
+    }
+    if (target_dir.empty()) {
+        fatal("Usage: " + std::string(argv[0]) + " -t target_dir [-x] [-d depth] --parameter1=value1 [--parameter2=value2 ...]");
+    }
+}
+)";
+
+static std::string cpp_literal(const std::string& text)
+{
+    std::ostringstream literal;
+    literal << "\"";
+    for (unsigned char c : text) {
+        switch (c) {
+            case '\\': literal << "\\\\"; break;
+            case '"': literal << "\\\""; break;
+            case '\n': literal << "\\n\"\n    \""; break;
+            case '\r': literal << "\\r"; break;
+            case '\t': literal << "\\t"; break;
+            default:
+                if (c < 0x20 || c >= 0x7f) {
+                    literal << "\\" << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>(c) << std::dec;
+                } else {
+                    literal << c;
+                }
+        }
+    }
+    literal << "\"";
+    return literal.str();
+}
+
+grammar::generator_compiler::generator_compiler(std::shared_ptr<grammar::model>& a_model) : walker_base(a_model, std::numeric_limits<int>::max())
+{
+}
+
+int grammar::generator_compiler::node_id(const pugi::xml_node& node)
+{
+    auto id = ids_.find(node.internal_object());
+    if (id != ids_.end()) {
+        return id->second;
+    }
+    ids_[node.internal_object()] = static_cast<int>(nodes_.size());
+    nodes_.push_back(node);
+    return static_cast<int>(nodes_.size()) - 1;
+}
+
+int grammar::generator_compiler::string_id(const std::string& text)
+{
+    auto id = string_ids_.find(text);
+    if (id != string_ids_.end()) {
+        return id->second;
+    }
+    string_ids_[text] = static_cast<int>(strings_.size());
+    strings_.push_back(text);
+    return static_cast<int>(strings_.size()) - 1;
+}
+
+std::string grammar::generator_compiler::visit(const pugi::xml_node& node, const std::string& path, const std::string& depth)
+{
+    // cdatas are pushed inline, all other nodes have their own function
+    if (type(node) == grammar::walker::node_type::cdata) {
+        return "code.push_back(strings[" + std::to_string(string_id(node.value())) + "]);";
+    }
+    return "node" + std::to_string(node_id(node)) + "(" + path + ", " + depth + ");";
+}
+
+void grammar::generator_compiler::compile_node(std::ostream& stream, const pugi::xml_node& node, int id)
+{
+    std::string name = node.name();
+    std::string output = node.attribute("output").value();
+    std::string open_output = output.empty() ? "" : "    output_file(" + cpp_literal(output) + ");\n";
+
+    stream << "// <" << name << ">" << std::endl;
+    stream << "static void node" << id << "(std::string parent, int depth)" << std::endl << "{" << std::endl;
+    if (type(node) == grammar::walker::node_type::call) {
+        stream << "    std::string path = parent + \"%\" + strings[" << string_id(name) << "];" << std::endl;
+        pugi::xpath_query element_q(("/gr:grammar/gr:derivations/" + name).c_str());
+        const auto& iter = Stats::xpath(element_q).evaluate_node_set(model_->grammar());
+        if (iter.size() == 0) {
+            stream << "    fatal(\"No definition for \" + std::string(strings[" << string_id(name) << "]) + \".\");" << std::endl;
+        }
+        for (auto& element : iter) {
+            stream << "    " << visit(element.node(), "path", "depth") << std::endl;
+        }
+    } else if (type(node) == grammar::walker::node_type::categorical) {
+        stream << "    if (parent.empty()) {" << std::endl;
+        stream << "        parent = strings[" << string_id(name) << "];" << std::endl;
+        stream << "    }" << std::endl;
+        stream << open_output;
+        stream << "    switch (take_choice(parent)) {" << std::endl;
+        int count = 0;
+        for (auto& choice : get_choice(node.children())) {
+            stream << "    case " << count << ":" << std::endl;
+            for (auto& child : choice) {
+                stream << "        " << visit(child, "parent + \"%" + std::to_string(count) + "\"", "depth") << std::endl;
+            }
+            stream << "        break;" << std::endl;
+            ++count;
+        }
+        stream << "    }" << std::endl;
+    } else if (type(node) == grammar::walker::node_type::recursive) {
+        stream << "    if (parent.empty()) {" << std::endl;
+        stream << "        parent = strings[" << string_id(name) << "];" << std::endl;
+        stream << "    }" << std::endl;
+        stream << "    std::string path = parent + \"@\" + std::to_string(depth);" << std::endl;
+        stream << open_output;
+        // same levels of walker_base::remaining_levels, the last one is
+        // folded in the configurations when only the base alternative is left
+        std::string levels = node.attribute("max-depth") ? std::to_string(remaining_levels(node, 0, 0)) + " - recursion_level(path, depth)" : "max_depth - depth";
+        int base = base_alternative(node);
+        std::string fallback = base == -1 ? "nullptr" : levels + " <= 1 ? \"" + std::to_string(base) + "\" : nullptr";
+        int list_recursive = list_recursion(node);
+        if (list_recursive != -1) {
+            stream << "    switch (take_level(path, parent, depth, " << list_recursive << ", " << fallback << ")) {" << std::endl;
+        } else {
+            stream << "    switch (take_choice(path, " << fallback << ")) {" << std::endl;
+        }
+        int count = 0;
+        for (auto& choice : get_choice(node.children())) {
+            stream << "    case " << count << ":" << std::endl;
+            bool recursive = false;
+            for (auto& child : choice) {
+                recursive = recursive || name == child.name();
+            }
+            if (recursive) {
+                stream << "        if (" << levels << " <= 1) {" << std::endl;
+                stream << "            fatal(\"Parameter '\" + path + \"' recurses deeper than the maximum depth of \" + std::string(strings[" << string_id(name) << "]) + \".\");" << std::endl;
+                stream << "        }" << std::endl;
+            }
+            for (auto& child : choice) {
+                if (name == child.name()) {
+                    std::string parent = "erase_last(parent, \"%\" + std::string(strings[" + std::to_string(string_id(name)) + "]))";
+                    stream << "        " << visit(child, parent, "depth + 1") << std::endl;
+                } else {
+                    stream << "        " << visit(child, "path + \"%" + std::to_string(count) + "\"", "depth + 1") << std::endl;
+                }
+            }
+            stream << "        break;" << std::endl;
+            ++count;
+        }
+        stream << "    }" << std::endl;
+    } else if (type(node) == grammar::walker::node_type::range) {
+        if (fixed_range(node)) {
+            stream << "    take(parent, \"\");" << std::endl;
+            stream << "    code.push_back(" << cpp_literal(node.attribute("min").value()) << ");" << std::endl;
+        } else {
+            stream << "    code.push_back(take(parent));" << std::endl;
+        }
+    } else if (type(node) == grammar::walker::node_type::plain) {
+        stream << open_output;
+        stream << "    std::string path = parent.empty() ? std::string(strings[" << string_id(name) << "]) : parent + \"%\";" << std::endl;
+        for (auto& child : node.children()) {
+            if (strcmp(child.name(), "or")) {
+                stream << "    " << visit(child, "path", "depth") << std::endl;
+            }
+        }
+    }
+    stream << "}" << std::endl << std::endl;
+}
+
+void grammar::generator_compiler::compile(std::ostream& stream)
+{
+    // the functions of the nodes are generated first since they collect the
+    // strings and the nodes reachable from the roots
+    std::vector<int> roots;
+    for (auto& root : output_roots()) {
+        roots.push_back(node_id(root));
+    }
+    std::ostringstream functions;
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        compile_node(functions, nodes_[i], static_cast<int>(i));
+    }
+
+    stream << "// This file has been generated by grammar2code " << G2C_VERSION << "." << std::endl;
+    stream << "// It generates the code for the grammar " << model_->grammar_path() << " without parsing it;" << std::endl;
+    stream << "// it has to be compiled with a C++17 compiler and then used as:" << std::endl;
+    stream << "//   generator -t target_dir [-x] [-d depth] --parameter1=value1 [--parameter2=value2 ...]" << std::endl << std::endl;
+    stream << "#include <algorithm>\n#include <cstdlib>\n#include <filesystem>\n#include <fstream>\n#include <iostream>\n";
+    stream << "#include <regex>\n#include <sstream>\n#include <string>\n#include <unordered_map>\n#include <vector>\n";
+    stream << generator_runtime << std::endl;
+
+    stream << "static const char *const strings[] = {" << std::endl;
+    for (auto& text : strings_) {
+        stream << "    " << cpp_literal(text) << "," << std::endl;
+    }
+    stream << "};" << std::endl << std::endl;
+
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        stream << "static void node" << i << "(std::string parent, int depth);" << std::endl;
+    }
+    stream << std::endl << functions.str();
+
+    stream << "int main(int argc, const char *argv[])" << std::endl << "{" << std::endl;
+    stream << "    parse_parameters(argc, argv);" << std::endl;
+    pugi::xpath_query single_files("/gr:grammar/gr:derivations/*[@source and @destination]");
+    for (auto& element : Stats::xpath(single_files).evaluate_node_set(model_->grammar())) {
+        boost::filesystem::path source(element.node().attribute("source").value());
+        boost::filesystem::path src = normalise_path(model_->grammar_path() / source);
+        stream << "    copy_single_file(" << cpp_literal(src.string()) << ", ";
+        stream << cpp_literal(element.node().attribute("destination").value()) << ");" << std::endl;
+    }
+    pugi::xpath_query filtered_files("/gr:grammar/gr:derivations/*[@source_dir and @destination_dir and @regex_filter]");
+    for (auto& element : Stats::xpath(filtered_files).evaluate_node_set(model_->grammar())) {
+        boost::filesystem::path source(element.node().attribute("source_dir").value());
+        boost::filesystem::path src = normalise_path(model_->grammar_path() / source);
+        stream << "    copy_filtered_files(" << cpp_literal(src.string()) << ", ";
+        stream << cpp_literal(element.node().attribute("destination_dir").value()) << ", ";
+        stream << cpp_literal(element.node().attribute("regex_filter").value()) << ");" << std::endl;
+    }
+    for (auto& root : roots) {
+        stream << "    node" << root << "(\"\", 0);" << std::endl;
+    }
+    stream << "    close_file();" << std::endl;
+    stream << "    for (auto &param : parameters) {" << std::endl;
+    stream << "        std::cerr << \"Warning: parameter \\\"\" << param.first << \" : \" << param.second;" << std::endl;
+    stream << "        std::cerr << \"\\\" was not used during code generation.\" << std::endl;" << std::endl;
+    stream << "    }" << std::endl;
+    stream << "    return EXIT_SUCCESS;" << std::endl << "}" << std::endl;
+}
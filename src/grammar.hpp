@@ -16,15 +16,21 @@
 #define G2C_VERSION "0.4-internal"
 
 #include <boost/filesystem.hpp>
+#include <boost/multiprecision/cpp_int.hpp>
 
+#include <map>
+#include <tuple>
 #include <unordered_map>
+#include <unordered_set>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
 #include <memory>
+#include <random>
 
 #include "pugixml.hpp"
+#include "trace.hpp"
 
 // regexp works on OS X with clang 4.2 but not yet on linux with GCC 4.7.2
 #ifdef __APPLE__
@@ -39,6 +45,132 @@ namespace regex_ns = boost;
 
 namespace grammar {
 
+    // the cleaned grammar lowered into flat arrays for the walks: the nodes of
+    // the derivations are stored contiguously in depth-first order, the
+    // alternatives of a node and their children are ranges of indices, names
+    // are interned, calls are resolved to the derivations they stand for and
+    // the CDATA are copied in a single arena; each node keeps its xml node for
+    // the attributes
+    class ir {
+    public:
+        //--------------------------------node kinds--------------------------------
+        // call         empty element <element/> that should be replaced by the
+        //              content of a derivation rule in the derivations list
+        // categorical  this is the standard rule that contains children separated
+        //              by <or/> elements
+        // recursive    rule that has a "call" rule among its children
+        // range        range rules usually they have a type attribute that allows
+        //              distinguishing between real-valued and integer-valued ranges
+        // copy         rule in the form <gr::copy source="..." destination="..." />
+        // cdata        pure text to be copied and pasted, no choices
+        // plain        node that contains only cdatas or "calls" to derivations
+        //              these nodes are usually top-level nodes with an output
+        //              attribute to generate a source file
+        //--------------------------------------------------------------------------
+        enum class kind : unsigned char {
+            call, categorical, recursive, range, copy, cdata, plain
+        };
+
+        // first index and number of elements in one of the arrays
+        struct slice {
+            unsigned first;
+            unsigned size;
+        };
+
+        struct node {
+            kind type;
+            // interned name, calls share it with the derivations they call
+            unsigned name;
+            // alternatives of categorical and recursive nodes, a single one
+            // with the children of plain nodes, none otherwise
+            slice alternatives;
+            // text of cdata nodes in the arena
+            slice text;
+            pugi::xml_node xml;
+        };
+
+        struct alternative {
+            slice children;
+            // calls the node it belongs to
+            bool recursive;
+        };
+
+        ir() {}
+
+        explicit ir(const pugi::xml_document &grammar);
+
+        static kind classify(const pugi::xml_node &node);
+
+        const node &at(unsigned id) const
+        {
+            return nodes_[id];
+        }
+
+        const alternative &alternative_at(unsigned index) const
+        {
+            return alternatives_[index];
+        }
+
+        unsigned child_at(unsigned index) const
+        {
+            return children_[index];
+        }
+
+        // derivations with the given interned name, as a slice of
+        // definition_at
+        slice definitions(unsigned name) const
+        {
+            return name < rules_.size() ? rules_[name] : slice{0, 0};
+        }
+
+        slice definitions(const std::string &name) const
+        {
+            auto it = name_ids_.find(name);
+            return it == name_ids_.end() ? slice{0, 0} : definitions(it->second);
+        }
+
+        unsigned definition_at(unsigned index) const
+        {
+            return definitions_[index];
+        }
+
+        // derivations with the output attribute, in document order
+        const std::vector<unsigned> &roots() const
+        {
+            return roots_;
+        }
+
+        // node of a derivation
+        unsigned id(const pugi::xml_node &derivation) const;
+
+        const std::string &name(unsigned name) const
+        {
+            return names_[name];
+        }
+
+        // NUL terminated
+        const char *text(const node &cdata) const
+        {
+            return arena_.c_str() + cdata.text.first;
+        }
+
+    private:
+        std::vector<node> nodes_;
+        std::vector<alternative> alternatives_;
+        std::vector<unsigned> children_;
+        std::vector<slice> rules_;
+        std::vector<unsigned> definitions_;
+        std::vector<unsigned> roots_;
+        std::vector<std::string> names_;
+        std::unordered_map<std::string, unsigned> name_ids_;
+        std::unordered_map<pugi::xml_node_struct *, unsigned> derivation_ids_;
+        std::string arena_;
+
+        unsigned intern(const char *name);
+
+        unsigned lower(const pugi::xml_node &xml);
+    };
+
     class model {
     public:
         model(boost::filesystem::path xml_file, boost::filesystem::path overwrite_xml_file);
@@ -47,9 +179,13 @@ namespace grammar {
 
         boost::filesystem::path grammar_path();
 
+        // the cleaned grammar lowered for the walks
+        const grammar::ir &lowered() const;
+
     private:
         pugi::xml_document grammar_;
         boost::filesystem::path base_path_;
+        grammar::ir lowered_;
 
         void load_grammar(boost::filesystem::path filename, pugi::xml_document &document);
 
@@ -72,6 +208,10 @@ namespace grammar {
 
         void clean_up_merge_disjuncitons();
 
+        // replaces the call target, surrounded by terminals, with the
+        // alternatives of rule, each with a copy of the terminals
+        bool factor_disjunction(const pugi::xml_node &rule, pugi::xml_node target);
+
         void clean_up_remove_duplicates();
 
         void clean_up_remove_non_used_rules();
@@ -87,14 +227,230 @@ namespace grammar {
         void rename_calls_inside_block(std::vector<pugi::xml_node> &block);
     };
 
-    class walker {
+    // state and helpers shared by all the walkers
+    class walker_base {
     public:
-        walker(std::shared_ptr<grammar::model> &a_model, int max_depth);
+        walker_base(std::shared_ptr<grammar::model> &a_model, int max_depth);
 
-        virtual ~walker();
+        // see grammar::ir::kind
+        typedef grammar::ir::kind node_type;
+
+    protected:
+        std::shared_ptr<grammar::model> model_;
+        int max_depth_;
+
+        ~walker_base() {}
+
+        std::vector<std::vector<pugi::xml_node>> get_choice(pugi::xml_object_range<pugi::xml_node_iterator> children);
+
+        // derivations with the output attribute, in the order they are walked
+        std::vector<pugi::xml_node> output_roots();
+
+        // whether the output roots can be walked at the same time: the paths
+        // start with the name of their root, so roots with distinct names do
+        // not share any path nor parameter
+        bool independent_roots(const std::vector<pugi::xml_node> &roots) const;
+
+        // TODO: duplicate of same function in model
+        bool has_children(const pugi::xml_node &node) const;
+
+        bool has_attributes(const pugi::xml_node &node) const;
+
+        node_type type(const pugi::xml_node &node);
+
+        // levels of a recursive node left, the current one included: depth
+        // counts all the recursive derivations along the path and is compared
+        // with max_depth_, level counts only the ones of the rule and is
+        // compared with its max-depth attribute
+        int remaining_levels(const pugi::xml_node &node, int level, int depth) const;
+
+        // level of a recursive node in its own recursion, 0 at the first one,
+        // from its path (ending with @depth): the first level is one deeper
+        // than the last recursive derivation before the rule on the path
+        static int recursion_level(const std::string &path, int depth);
+
+        // index of the recursive alternative of a list-like rule, with one
+        // base alternative and one alternative with a single self-call; -1 if
+        // the rule has another form
+        int list_recursion(const pugi::xml_node &node);
+
+        // index of the only alternative without self-calls of a recursive
+        // rule, -1 if there are more
+        int base_alternative(const pugi::xml_node &node);
+
+        // range with min equal to max
+        bool fixed_range(const pugi::xml_node &node) const;
+    };
+
+    // depth first walk of the lowered grammar pulled one event at a time:
+    // the walk stops after each event, and continues only when the next one
+    // is asked, so that a consumer can stop early or interleave the walk with
+    // other work; the events are those of the callbacks of walker, plus the
+    // beginning of each output root
+    class walk_cursor : public walker_base {
+    public:
+        struct event {
+            enum event_type {
+                // a derivation with the output attribute begins
+                output,
+                call, choice, begin_alternative, end_choice, range, copy, cdata, plain
+            };
+            event_type type;
+            pugi::xml_node node;
+            // as passed to the callbacks of walker
+            std::string path;
+            int depth;
+            // index of the alternative, or the number of alternatives of a
+            // choice
+            int alternative;
+            // the choice is on a recursive node
+            bool recursive;
+        };
+
+        walk_cursor(std::shared_ptr<grammar::model> &a_model, int max_depth);
+
+        // a copy starts without any walk
+        walk_cursor(const walk_cursor &other);
+
+        void set_max_depth(int max_depth);
+
+        // walks the derivations with the output attribute, or a single one;
+        // a walk can be started while another one is in progress, and the
+        // events of the new one come first
+        void start();
+
+        void start(const pugi::xml_node &root);
+
+        // the next event of the walk started last, false at its end
+        // (walk_cursor.hpp)
+        inline bool next();
+
+        const event &current() const
+        {
+            return event_;
+        }
+
+        // after a choice event, walks only the given alternative (-1 for all
+        // of them, the default)
+        void select(int alternative);
+
+        // drops the rest of the walk started last
+        void stop();
+
+    private:
+        // a step of the walk: a node to visit (a root also with its output
+        // event), or the event that precedes the children of an alternative,
+        // or that follows the last one, or the end of the trace span of a
+        // call; the path of the step is the range [path, path + length) of
+        // paths_
+        struct frame {
+            enum step_type : unsigned char {
+                visit_root, visit, begin_alternative, end_choice, end_span
+            };
+            step_type step;
+            int alternative;
+            unsigned id;
+            int depth;
+            unsigned path;
+            unsigned length;
+        };
+
+        // node of the last event, whose children are pushed only when the
+        // next event is asked, after the choice of the consumer
+        struct expansion {
+            bool pending;
+            unsigned id;
+            int depth;
+            std::string parent;
+            int selected;
+        };
+
+        // a walk ends when the steps are back to base, and the expansion
+        // suspended by its start is resumed
+        struct walk {
+            size_t base;
+            expansion suspended;
+        };
+
+        // pending steps, the last one is the next; the paths of the steps are
+        // stored in the same order in paths_, so that a step always owns its
+        // tail
+        std::vector<frame> frames_;
+        std::string paths_;
+        std::vector<walk> walks_;
+        std::vector<std::unique_ptr<Trace::span>> spans_;
+
+        event event_;
+        expansion expansion_;
+
+        void begin_walk();
+
+        inline void push(frame::step_type step, unsigned id, int depth, int alternative, const std::string &path);
+
+        void expand();
+    };
+
+    // depth first walk of the lowered grammar, calling the callbacks of
+    // Derived (see walker for their meaning) for the events of a walk_cursor;
+    // the callbacks are resolved at compile time, so that they can be inlined
+    // in the walk by the translation units that instantiate it
+    // (basic_walker.hpp)
+    template <class Derived>
+    class basic_walker : public walker_base {
+    public:
+        basic_walker(std::shared_ptr<grammar::model> &a_model, int max_depth) : walker_base(a_model, max_depth),
+                                                                              cursor_(a_model, max_depth) {}
 
         void walk();
 
+        // walks a single derivation with the output attribute
+        void walk(const pugi::xml_node &root);
+
+        // the callbacks of Derived can take the path by const reference, and
+        // those it does not declare do nothing
+        void callback_call(const pugi::xml_node &node, const std::string &path, int depth) {}
+
+        void callback_range(const pugi::xml_node &node, const std::string &path, int depth) {}
+
+        void callback_copy(const pugi::xml_node &node, const std::string &path, int depth) {}
+
+        void callback_cdata(const pugi::xml_node &node, const std::string &path, int depth) {}
+
+        void callback_plain(const pugi::xml_node &node, const std::string &path, int depth) {}
+
+        void callback_alternative(const pugi::xml_node &node, const std::string &path, int depth, int alternative) {}
+
+        void callback_end_choice(const pugi::xml_node &node, const std::string &path, int depth) {}
+
+    protected:
+        ~basic_walker() {}
+
+        // calls the callback of an event, and returns the alternative chosen
+        // by a categorical or recursive callback (-1 for all of them, and
+        // for the other events)
+        int handle(const walk_cursor::event &event);
+
+    private:
+        // reused by all the walks
+        walk_cursor cursor_;
+
+        Derived &derived()
+        {
+            return static_cast<Derived &>(*this);
+        }
+
+        // handles the events until the end of the walk started last
+        void dispatch();
+    };
+
+    // walker with virtual callbacks, for the walkers that are not known when
+    // the walk is compiled
+    class walker : public basic_walker<walker> {
+    public:
+        walker(std::shared_ptr<grammar::model> &a_model, int max_depth);
+
+        virtual ~walker();
+
         // NOTE: categorical and recursive callbacks return the actual choice done
         //       this allows to prune the DFS when generating the final code, and
         //       most importantly visiting only the required nodes allows us to
@@ -117,148 +473,258 @@ namespace grammar {
 
         virtual void callback_plain(const pugi::xml_node &node, std::string path, int depth) = 0;
 
-    protected:
-        std::shared_ptr<grammar::model> model_;
-        int max_depth_;
+        // called before walking the children of each alternative of a
+        // categorical or recursive node, and after the last alternative; the
+        // path is the same passed to the categorical or recursive callback
+        virtual void callback_alternative(const pugi::xml_node &node, std::string path, int depth, int alternative);
 
-        //--------------------------------node types--------------------------------
-        // call         empty element <element/> that should be replaced by the
-        //              content of a derivation rule in the derivations list
-        // categorical  this is the standard rule that contains children separated
-        //              by <or/> elements
-        // recursive    rule that has a "call" rule among its children
-        // range        range rules usually they have a type attribute that allows
-        //              distinguishing between real-valued and integer-valued ranges
-        // copy         rule in the form <gr::copy source="..." destination="..." />
-        // cdata        pure text to be copied and pasted, no choices
-        // plain        node that contains only cdatas or "calls" to derivations
-        //              these nodes are usually top-level nodes with an output
-        //              attribute to generate a source file
-        //--------------------------------------------------------------------------
-        enum class node_type {
-            call, categorical, recursive, range, copy, cdata, plain
-        };
+        virtual void callback_end_choice(const pugi::xml_node &node, std::string path, int depth);
+    };
 
-        std::vector<std::vector<pugi::xml_node>> get_choice(pugi::xml_object_range<pugi::xml_node_iterator> children);
+    // parameters of the grammar in the format of a tool for automatic
+    // algorithm configuration
+    class configuration {
+    public:
+        virtual ~configuration() {}
 
-        // TODO: duplicate of same function in model
-        bool has_children(const pugi::xml_node &node) const;
+        // the configuration of a format given by its name in lower case
+        // ('irace', 'paramils', 'smac', 'emili' or 'crace')
+        static std::shared_ptr<configuration> make(const std::string &format, std::shared_ptr<grammar::model> &a_model, int max_depth);
 
-        bool has_attributes(const pugi::xml_node &node) const;
+        // walks the grammar and writes the parameters
+        virtual void print(std::ostream &stream) = 0;
 
-    private:
-        void do_walk(const pugi::xml_node &node, std::string parent, int depth);
+        // writes the parameters of the last walk, without walking again
+        virtual void write(std::ostream &stream) = 0;
 
-        node_type type(const pugi::xml_node &node);
+        virtual void printToFile(const std::string &filename) {}
+
+        // the parameters can also be generated from a walk shared with other
+        // formats (see emitter): begin is called before the walk, consume
+        // for each of its events and end after it
+        virtual void begin() = 0;
+
+        virtual void consume(const walk_cursor::event &event) = 0;
+
+        virtual void end() = 0;
+
+        // encodes list-like recursions with a single ordinal parameter,
+        // path@reps, counting how many times the recursion is taken
+        void set_recursion_count(bool recursion_count) { recursion_count_ = recursion_count; }
+
+        // keeps the parameters with a single value, which are otherwise
+        // folded as constants and not printed
+        void set_keep_degenerate(bool keep_degenerate) { keep_degenerate_ = keep_degenerate; }
+
+    protected:
+        bool recursion_count_ = false;
+        bool keep_degenerate_ = false;
     };
 
-    class configuration : public walker {
+    // the parameters of the walk formatted by Format, which implements
+    // fmt_rule_name, fmt_rule_cond and fmt_parameter; Format is also the
+    // walker, so that it can replace the callbacks, and both the callbacks
+    // and the formatting are resolved at compile time (basic_configuration.hpp)
+    template <class Format>
+    class basic_configuration : public configuration, public basic_walker<Format> {
     public:
-        configuration(std::shared_ptr<grammar::model> &a_model, int max_depth) : walker(a_model, max_depth) {};
+        basic_configuration(std::shared_ptr<grammar::model> &a_model, int max_depth) : basic_walker<Format>(a_model, max_depth) {};
 
-        virtual ~configuration() {}
+        virtual ~basic_configuration() {}
 
-        virtual void callback_call(const pugi::xml_node &node, std::string path, int depth);
+        void callback_call(const pugi::xml_node &node, const std::string &path, int depth);
 
-        virtual int callback_categorical(const pugi::xml_node &node, std::string path, int depth);
+        int callback_categorical(const pugi::xml_node &node, const std::string &path, int depth);
 
-        virtual int callback_recursive(const pugi::xml_node &node, std::string path, int depth);
+        int callback_recursive(const pugi::xml_node &node, const std::string &path, int depth);
 
-        virtual void callback_range(const pugi::xml_node &node, std::string path, int depth);
+        void callback_range(const pugi::xml_node &node, const std::string &path, int depth);
 
-        virtual void callback_copy(const pugi::xml_node &node, std::string path, int depth);
+        void callback_copy(const pugi::xml_node &node, const std::string &path, int depth);
 
-        virtual void callback_cdata(const pugi::xml_node &node, std::string path, int depth);
+        void callback_cdata(const pugi::xml_node &node, const std::string &path, int depth);
 
-        virtual void callback_plain(const pugi::xml_node &node, std::string path, int depth);
+        void callback_plain(const pugi::xml_node &node, const std::string &path, int depth);
 
         virtual void print(std::ostream &stream);
 
-        virtual void printToFile(const std::string &filename) {}
+        virtual void write(std::ostream &stream);
+
+        virtual void begin();
+
+        virtual void consume(const walk_cursor::event &event);
+
+        virtual void end();
 
     protected:
         std::vector<std::string> parameters_;
 
+        // conditions of the folded parameters, by path; the parameters
+        // conditional on a folded one take its condition
+        std::unordered_map<std::string, std::pair<std::string, std::string>> folded_;
+
         // in the format parameter function there is also a default value and a log-scale value
         // that are taken in consideration only by some type of parameters for some specific
         // parameter formats
-        virtual std::string fmt_rule_name(const std::string &path) = 0;
-
-        virtual std::string
-        fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1) = 0;
-
-        virtual void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
-                                   const std::vector<std::string> &values, std::string default_value, bool log_scale,
-                                   std::string rule_cond) = 0;
-
         std::pair<std::string, std::string> rule_name(const std::string &path);
 
         std::pair<std::string, std::string>
         rule_cond(const std::string &path, const std::string &node_name, int rec_index);
 
+        // true if the parameter is folded, to be called only for parameters
+        // with a single value
+        bool fold_degenerate(const std::string &path, const std::string &node_name, int rec_index = -1);
+
+        // walks the grammar, each output root with a copy of the format when
+        // they can be walked at the same time
+        void generate();
+
+        // clears the parameters before a walk, and appends the parameters of
+        // a copy that walked the next output root; the formats with state of
+        // their own extend both
+        void reset();
+
+        void merge(Format &worker);
+
     private:
         // store parameter names to extra check that ther are no duplicates
         std::vector<std::string> parameter_names_;
 
+        // recursions encoded by their count, by path without the depth
+        struct recursion_count {
+            int start;
+            int levels;
+            int recursive;
+        };
+
+        std::unordered_map<std::string, recursion_count> recursion_counts_;
+
+        Format &format()
+        {
+            return static_cast<Format &>(*this);
+        }
+
         void stop_if_duplicate_parameters(std::string parameter);
     };
 
-    class irace_conf : public configuration {
+    // format with virtual functions, for the formats that are not known when
+    // the library is compiled
+    class virtual_configuration : public basic_configuration<virtual_configuration> {
     public:
-        irace_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : configuration(a_model, max_depth) {};
+        virtual_configuration(std::shared_ptr<grammar::model> &a_model, int max_depth) : basic_configuration(a_model, max_depth) {};
 
-        virtual ~irace_conf() {}
+        virtual ~virtual_configuration() {}
 
-    protected:
-        virtual std::string fmt_rule_name(const std::string &path);
+        virtual std::string fmt_rule_name(const std::string &path) = 0;
 
-        virtual std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+        virtual std::string
+        fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1) = 0;
 
         virtual void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
                                    const std::vector<std::string> &values, std::string default_value, bool log_scale,
-                                   std::string rule_cond);
+                                   std::string rule_cond) = 0;
     };
 
-    class smac_conf : public configuration {
+    class irace_conf : public basic_configuration<irace_conf> {
     public:
-        smac_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : configuration(a_model, max_depth) {};
+        irace_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : basic_configuration(a_model, max_depth) {};
+
+        virtual ~irace_conf() {}
+
+    protected:
+        friend class basic_configuration<irace_conf>;
+
+        std::string fmt_rule_name(const std::string &path);
+
+        std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+
+        void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
+                           const std::vector<std::string> &values, std::string default_value, bool log_scale,
+                           std::string rule_cond);
+    };
+
+    class smac_conf : public basic_configuration<smac_conf> {
+    public:
+        smac_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : basic_configuration(a_model, max_depth) {};
 
         virtual ~smac_conf() {}
 
-        virtual void print(std::ostream &stream);
+        virtual void write(std::ostream &stream);
 
     protected:
+        friend class basic_configuration<smac_conf>;
+
         std::vector<std::string> conditionals_;
 
-        virtual std::string fmt_rule_name(const std::string &path);
+        void reset();
 
-        virtual std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+        void merge(smac_conf &worker);
 
-        virtual void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
-                                   const std::vector<std::string> &values, std::string default_value, bool log_scale,
-                                   std::string rule_cond);
+        std::string fmt_rule_name(const std::string &path);
+
+        std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+
+        void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
+                           const std::vector<std::string> &values, std::string default_value, bool log_scale,
+                           std::string rule_cond);
     };
 
-    class paramils_conf : public configuration {
+    class paramils_conf : public basic_configuration<paramils_conf> {
     public:
-        paramils_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : configuration(a_model, max_depth) {};
+        paramils_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : basic_configuration(a_model, max_depth) {};
 
         virtual ~paramils_conf() {}
 
-        virtual void callback_range(const pugi::xml_node &node, std::string path, int depth);
+        void callback_range(const pugi::xml_node &node, const std::string &path, int depth);
 
-        virtual void print(std::ostream &stream);
+        virtual void write(std::ostream &stream);
 
     protected:
+        friend class basic_configuration<paramils_conf>;
+
         std::vector<std::string> conditionals_;
 
-        virtual std::string fmt_rule_name(const std::string &path);
+        void reset();
 
-        virtual std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+        void merge(paramils_conf &worker);
 
-        virtual void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
-                                   const std::vector<std::string> &values, std::string default_value, bool log_scale,
-                                   std::string rule_cond);
+        std::string fmt_rule_name(const std::string &path);
+
+        std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+
+        void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
+                           const std::vector<std::string> &values, std::string default_value, bool log_scale,
+                           std::string rule_cond);
+    };
+
+    // cache of the code generated for the output files, shared by the
+    // params2code instances of a batch; an entry is keyed on the output root
+    // and on the parameters (names and values) reachable from it, so that the
+    // candidates that differ only in the parameters of other files can reuse
+    // the code without walking the derivations again
+    class code_cache {
+    public:
+        code_cache() : hits_(0), misses_(0) {};
+
+        // the code of an output file, along with the names of the parameters
+        // consumed by the walk that generated it
+        bool lookup(const std::string &key, std::string &code, std::vector<std::string> &consumed);
+
+        void store(const std::string &key, const std::string &code, const std::vector<std::string> &consumed);
+
+        long hits() const;
+
+        long misses() const;
+
+    private:
+        struct entry {
+            std::string code;
+            std::vector<std::string> consumed;
+        };
+
+        std::unordered_map<std::string, entry> entries_;
+        long hits_;
+        long misses_;
     };
 
     class params2code : public walker {
@@ -270,6 +736,24 @@ namespace grammar {
 
         void generate_code();
 
+        // NOTE: the cache, as the concurrent walk of the output roots,
+        //       assumes that each derivation with the output attribute
+        //       generates exactly one file
+        void set_cache(std::shared_ptr<code_cache> cache);
+
+        // files written or copied by generate_code, relative to target_dir
+        const std::vector<boost::filesystem::path> &generated_files() const;
+
+        // the code generated under every configuration at the beginning of
+        // the C/C++ output files is written once in invariant_dir, and the
+        // output files include it instead of repeating it
+        void set_invariant_dir(boost::filesystem::path invariant_dir);
+
+        // --depth of the configurations: when its parameter is missing, the
+        // last level of a recursion, folded in the configurations since only
+        // its base alternative is left, takes that alternative
+        void set_max_depth(int max_depth);
+
         virtual void callback_call(const pugi::xml_node &node, std::string path, int depth);
 
         virtual int callback_categorical(const pugi::xml_node &node, std::string path, int depth);
@@ -284,48 +768,370 @@ namespace grammar {
 
         virtual void callback_plain(const pugi::xml_node &node, std::string path, int depth);
 
-    private:
-        std::unordered_map<std::string, std::string> parameters_;
-        std::unordered_map<std::string, std::string> parameters_bckp_;
+    protected:
         boost::filesystem::path target_dir_;
         std::ostream &stream_;
-        bool do_not_reindent_;
         std::vector<std::string> code_;
+        std::vector<boost::filesystem::path> files_;
+        boost::filesystem::path current_output_;
+
+        bool do_not_reindent_;
+
+        // C and C++ sources and headers, which can be reindented and can
+        // include the headers of the invariant code
+        static bool is_c_family(const boost::filesystem::path &file);
+
+        virtual void output_file(boost::filesystem::path output_file);
+
+        virtual std::string render_code();
+
+        // a generator of the same kind for walking an output root on its own,
+        // with the same parameters and writing its messages on stream
+        virtual std::unique_ptr<params2code> root_worker(std::ostream &stream);
+
+    private:
+        std::unordered_map<std::string, std::string> parameters_;
+        std::unordered_map<std::string, std::string> parameters_bckp_;
+
+        // set in the workers, whose output files are opened and written by
+        // the generator that merges their code
+        bool deferred_output_;
+
+        // recursions encoded by their count (path@reps), by path without the
+        // depth: depth of the first level and count
+        std::unordered_map<std::string, std::pair<int, int>> recursion_counts_;
 
         std::unique_ptr<std::ofstream> current_fout_;
+        std::shared_ptr<code_cache> cache_;
+        boost::filesystem::path invariant_dir_;
+        std::unordered_map<std::string, std::string> invariants_;
 
-        void write_and_close_current_output_file();
+        // choice of a level of a recursion given as path@reps, -1 if there
+        // is no such parameter
+        int recursion_count_choice(const pugi::xml_node &node, const std::string &path, int depth);
+
+        bool collect_invariant(const pugi::xml_node &node, std::string &text);
+
+        std::string invariant_header(const boost::filesystem::path &output, const std::string &invariant);
+
+        std::string render_code(const std::string &code);
+
+        std::string cache_key(const pugi::xml_node &root) const;
 
-        void output_file(boost::filesystem::path output_file);
+        // names of the parameters under root, and the ones of them that the
+        // walk of root has consumed
+        std::vector<std::string> root_parameters(const pugi::xml_node &root) const;
+
+        std::vector<std::string> consumed_parameters(const std::vector<std::string> &names) const;
+
+        void consume_parameters(const std::vector<std::string> &names);
+
+        // walks each root with a worker of its own, or takes its code from
+        // the cache, and writes the code in the order of the roots
+        void walk_roots(const std::vector<pugi::xml_node> &roots);
+
+        void write_code(const std::string &code);
+
+        void write_and_close_current_output_file();
 
         void copy_single_files();
 
         void copy_files_with_filter();
     };
 
-    class emili_conf : public configuration {
+    // generates a single program for all the configurations: each choice
+    // becomes a switch on a parameter read at runtime from the same command
+    // line (--parameter=value) passed by the tool for automatic algorithm
+    // configuration, and each range a value read at runtime; the program has
+    // to call g2c_init(argc, argv) (g2c_runtime.h) before any choice is made
+    //
+    // NOTE: only choices inside the body of a function and at the beginning
+    //       of a statement can be dispatched at runtime
+    class superset_code : public params2code {
+    public:
+        superset_code(std::shared_ptr<grammar::model> &a_model, int max_depth, boost::filesystem::path target_dir,
+                      std::ostream &stream, bool do_not_reindent);
+
+        virtual ~superset_code() {}
+
+        void generate_code();
+
+        virtual int callback_categorical(const pugi::xml_node &node, std::string path, int depth);
+
+        virtual int callback_recursive(const pugi::xml_node &node, std::string path, int depth);
+
+        virtual void callback_range(const pugi::xml_node &node, std::string path, int depth);
+
+        virtual void callback_alternative(const pugi::xml_node &node, std::string path, int depth, int alternative);
+
+        virtual void callback_end_choice(const pugi::xml_node &node, std::string path, int depth);
+
+    protected:
+        virtual std::string render_code();
+
+        virtual std::unique_ptr<params2code> root_worker(std::ostream &stream);
+
+    private:
+        // for each open switch, whether a case has already been opened and
+        // the indentation of the line where the switch begins
+        std::vector<bool> open_cases_;
+        std::vector<std::string> indentations_;
+        // for each choice being walked, whether it is dispatched at runtime
+        // or folded to a single alternative
+        std::vector<bool> dispatched_;
+
+        int dispatch(const pugi::xml_node &node, std::string path, int depth);
+
+        void write_runtime();
+    };
+
+    // emits along with the generated code of a candidate a unity translation
+    // unit including all its sources and a ninja file to build it; for a
+    // batch of candidates a top-level ninja file builds all of them in one
+    // invocation, compiling only once the candidates with identical files
+    class build_graph {
     public:
-        emili_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : configuration(a_model, max_depth),
+        build_graph(std::string compiler, std::string compiler_flags, std::string linker_flags, std::string executable);
+
+        void add_candidate(const boost::filesystem::path &target_dir,
+                           const std::vector<boost::filesystem::path> &files);
+
+        void write_batch(const boost::filesystem::path &batch_dir);
+
+    private:
+        struct candidate {
+            boost::filesystem::path dir;
+            std::string unity;
+            std::string compiler;
+            // name of the object shared by the candidates with the same files
+            std::string object;
+        };
+
+        std::string compiler_;
+        std::string compiler_flags_;
+        std::string linker_flags_;
+        std::string executable_;
+        std::vector<candidate> candidates_;
+        // objects by compiler and content of the files
+        std::unordered_map<std::string, size_t> objects_;
+
+        void write_rules(std::ostream &stream, const std::string &compiler, const std::string &include_dir);
+    };
+
+    // translates the grammar into the C++17 source of a standalone generator
+    // with the same command line and output of params2code; every node
+    // reachable from the output roots becomes a function, choices become
+    // switch statements and the text a static table, so the generator does
+    // not parse any XML nor evaluate any XPath
+    //
+    // NOTE: the grammar is not walked, the nodes are translated one by one,
+    //       so only the helpers of walker_base are needed
+    class generator_compiler : public walker_base {
+    public:
+        generator_compiler(std::shared_ptr<grammar::model> &a_model);
+
+        ~generator_compiler() {}
+
+        void compile(std::ostream &stream);
+
+    private:
+        std::vector<pugi::xml_node> nodes_;
+        std::unordered_map<pugi::xml_node_struct *, int> ids_;
+        std::vector<std::string> strings_;
+        std::unordered_map<std::string, int> string_ids_;
+
+        int node_id(const pugi::xml_node &node);
+
+        int string_id(const std::string &text);
+
+        std::string visit(const pugi::xml_node &node, const std::string &path, const std::string &depth);
+
+        void compile_node(std::ostream &stream, const pugi::xml_node &node, int id);
+    };
+
+    // counts the distinct derivations of each output root up to the maximum
+    // recursion depth without enumerating them, the count of a node at a given
+    // depth and level of its own recursion (see walker_base::recursion_level)
+    // is memoized since it does not depend on the rest of the path; ranges,
+    // copies and cdatas count as a single derivation
+    class design_space : public walker_base {
+    public:
+        design_space(std::shared_ptr<grammar::model> &a_model, int max_depth);
+
+        virtual ~design_space() {}
+
+        // product of the counts of the output roots
+        boost::multiprecision::cpp_int count();
+
+        boost::multiprecision::cpp_int count(const pugi::xml_node &node, int depth, int level);
+
+        // counts of the alternatives of a categorical or recursive node, in
+        // the same order of the choices; alternatives of a recursive node
+        // that would exceed the maximum depth count zero
+        std::vector<boost::multiprecision::cpp_int> alternative_counts(const pugi::xml_node &node, int depth, int level);
+
+        void print(std::ostream &stream);
+
+        // the configurations of the sampler and of the enumerator are in the
+        // same space of the parameter files (see
+        // configuration::set_recursion_count and set_keep_degenerate)
+        void set_recursion_count(bool recursion_count) { recursion_count_ = recursion_count; }
+
+        void set_keep_degenerate(bool keep_degenerate) { keep_degenerate_ = keep_degenerate; }
+
+        // starts the assignment of a new configuration
+        void begin_assignment();
+
+        // adds the choice of a categorical or recursive node to the
+        // assignment, as the parameter files encode it: nothing for a folded
+        // last level, and a count for the levels of a list-like recursion
+        void assign(std::vector<std::pair<std::string, std::string>> &assignment, const pugi::xml_node &node,
+                    const std::string &path, int depth, int choice);
+
+        // whether a range is a parameter of the configurations
+        bool assigned(const pugi::xml_node &range) const;
+
+    private:
+        std::map<std::tuple<pugi::xml_node_struct *, int, int>, boost::multiprecision::cpp_int> counts_;
+        std::unordered_map<std::string, std::vector<pugi::xml_node>> definitions_;
+        bool recursion_count_ = false;
+        bool keep_degenerate_ = false;
+
+        // recursions encoded by their count in the configuration being
+        // assigned, by path without the depth: depth of the first level and
+        // index of the count in the assignment (-1 if folded)
+        std::unordered_map<std::string, std::pair<int, int>> recursion_counts_;
+
+        // derivations the call resolves to
+        const std::vector<pugi::xml_node> &definitions(const pugi::xml_node &node);
+    };
+
+    // draws configurations uniformly over the derivations up to the maximum
+    // recursion depth: each alternative is chosen with a probability
+    // proportional to the number of derivations below it, optionally
+    // multiplied by a per-rule weight; ranges are sampled uniformly (in log
+    // scale if so specified)
+    class sampler : public basic_walker<sampler> {
+    public:
+        sampler(std::shared_ptr<grammar::model> &a_model, int max_depth, unsigned long seed);
+
+        // file with one rule per line followed by the weights of its
+        // alternatives (rule w0 w1 ...)
+        void load_weights(const boost::filesystem::path &weights_file);
+
+        // command line names and values of the parameters of a configuration
+        const std::vector<std::pair<std::string, std::string>> &sample();
+
+        // see design_space::set_recursion_count and set_keep_degenerate
+        void set_recursion_count(bool recursion_count) { space_.set_recursion_count(recursion_count); }
+
+        void set_keep_degenerate(bool keep_degenerate) { space_.set_keep_degenerate(keep_degenerate); }
+
+        int callback_categorical(const pugi::xml_node &node, const std::string &path, int depth);
+
+        int callback_recursive(const pugi::xml_node &node, const std::string &path, int depth);
+
+        void callback_range(const pugi::xml_node &node, const std::string &path, int depth);
+
+    private:
+        design_space space_;
+        std::mt19937_64 generator_;
+        std::unordered_map<std::string, std::vector<double>> weights_;
+        std::map<std::tuple<pugi::xml_node_struct *, int, int>, std::discrete_distribution<int>> distributions_;
+        std::vector<std::pair<std::string, std::string>> assignment_;
+
+        int choose(const pugi::xml_node &node, const std::string &path, int depth);
+    };
+
+    // enumerates the configurations in a canonical order, the configuration
+    // with a given index is computed by a mixed radix decomposition of the
+    // index over the choices in the order they are walked, so that only the
+    // index has to be kept between two configurations; ranges take their
+    // default value, and are left out when fixed like in the parameter files
+    class enumerator : public basic_walker<enumerator> {
+    public:
+        enumerator(std::shared_ptr<grammar::model> &a_model, int max_depth);
+
+        // number of configurations
+        const boost::multiprecision::cpp_int &count() const;
+
+        // restricts the enumeration to the indices in [begin, end)
+        void set_range(const boost::multiprecision::cpp_int &begin, const boost::multiprecision::cpp_int &end);
+
+        // index of the next configuration
+        const boost::multiprecision::cpp_int &cursor() const;
+
+        // moves to the next configuration, false at the end of the range
+        bool next();
+
+        // command line names and values of the parameters of the current
+        // configuration
+        const std::vector<std::pair<std::string, std::string>> &assignment() const;
+
+        // see design_space::set_recursion_count and set_keep_degenerate
+        void set_recursion_count(bool recursion_count) { space_.set_recursion_count(recursion_count); }
+
+        void set_keep_degenerate(bool keep_degenerate) { space_.set_keep_degenerate(keep_degenerate); }
+
+        int callback_categorical(const pugi::xml_node &node, const std::string &path, int depth);
+
+        int callback_recursive(const pugi::xml_node &node, const std::string &path, int depth);
+
+        void callback_range(const pugi::xml_node &node, const std::string &path, int depth);
+
+        void callback_end_choice(const pugi::xml_node &node, const std::string &path, int depth);
+
+    private:
+        // index still to be decomposed among the choices of an alternative
+        // and product of the counts of the choices not yet walked
+        struct frame {
+            boost::multiprecision::cpp_int index;
+            boost::multiprecision::cpp_int divisor;
+        };
+
+        design_space space_;
+        std::vector<frame> frames_;
+        boost::multiprecision::cpp_int total_;
+        boost::multiprecision::cpp_int cursor_;
+        boost::multiprecision::cpp_int end_;
+        std::vector<std::pair<std::string, std::string>> assignment_;
+
+        int choose(const pugi::xml_node &node, const std::string &path, int depth);
+    };
+
+    class emili_conf : public basic_configuration<emili_conf> {
+    public:
+        emili_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : basic_configuration(a_model, max_depth),
                                                                               once(1) {};
 
+        // the parameters are not generated by a walk but from the components
+        // found in the grammar
         virtual void print(std::ostream &stream);
 
+        virtual void write(std::ostream &stream);
+
+        virtual void consume(const walk_cursor::event &event);
+
+        virtual void end();
+
         virtual void printToFile(const std::string &filename);
 
         virtual ~emili_conf() {}
 
     protected:
+        friend class basic_configuration<emili_conf>;
+
         int once;
         std::vector<std::string> header_;
         std::string cname;
 
-        virtual std::string fmt_rule_name(const std::string &path);
+        std::string fmt_rule_name(const std::string &path);
 
-        virtual std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+        std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
 
-        virtual void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
-                                   const std::vector<std::string> &values, std::string default_value, bool log_scale,
-                                   std::string rule_cond);
+        void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
+                           const std::vector<std::string> &values, std::string default_value, bool log_scale,
+                           std::string rule_cond);
 
         virtual void writeParametersCode(const char *parameter_name, int parameter_index);
 
@@ -352,22 +1158,120 @@ namespace grammar {
         virtual void startClass();
 
         virtual void endClass();
+
+    private:
+        void build();
     };
 
-    class crace_conf : public configuration {
+    class crace_conf : public basic_configuration<crace_conf> {
     public:
-        crace_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : configuration(a_model, max_depth) {};
+        crace_conf(std::shared_ptr<grammar::model> &a_model, int max_depth) : basic_configuration(a_model, max_depth) {};
 
         virtual ~crace_conf() {}
 
     protected:
-        virtual std::string fmt_rule_name(const std::string &path);
+        friend class basic_configuration<crace_conf>;
 
-        virtual std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+        std::string fmt_rule_name(const std::string &path);
 
-        virtual void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
-                                   const std::vector<std::string> &values, std::string default_value, bool log_scale,
-                                   std::string rule_cond);
+        std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+
+        void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
+                           const std::vector<std::string> &values, std::string default_value, bool log_scale,
+                           std::string rule_cond);
+    };
+
+    // walks the grammar once for several formats of the parameters, which
+    // generate their parameters from the events of the same walk and are
+    // then written each with its write; all the alternatives are walked
+    class emitter {
+    public:
+        emitter(std::shared_ptr<grammar::model> &a_model, int max_depth);
+
+        void add(std::shared_ptr<configuration> format);
+
+        void walk();
+
+    private:
+        walk_cursor cursor_;
+        std::vector<std::shared_ptr<configuration>> formats_;
+    };
+
+    // table of the parameters with their domains and conditions, compiled
+    // once from the grammar and then used for checking and completing
+    // configurations without walking the grammar
+    class parameter_space : public basic_configuration<parameter_space> {
+    public:
+        parameter_space(std::shared_ptr<grammar::model> &a_model, int max_depth, bool keep_degenerate = false, bool recursion_count = false);
+
+        virtual ~parameter_space() {}
+
+        struct parameter {
+            // command line name
+            std::string name;
+            // categorical, ordinal, int or real
+            std::string type;
+            // choices of a categorical or ordinal parameter, min and max of a range
+            std::vector<std::string> values;
+            std::string default_value;
+            bool log_scale;
+            // index of the parameter in the condition (-1 for no condition)
+            // and the values for which this parameter is active
+            int parent;
+            std::vector<std::string> parent_values;
+        };
+
+        struct report {
+            std::vector<std::string> missing;
+            std::vector<std::string> out_of_range;
+            std::vector<std::string> inactive;
+            std::vector<std::string> unknown;
+
+            bool valid() const;
+
+            void print(std::ostream &stream) const;
+        };
+
+        // parameters in the order they are walked, the parent of a parameter
+        // comes always before it
+        const std::vector<parameter> &parameters() const;
+
+        // when complete is set the missing parameters take their default
+        // value, and the inactive, unknown and folded parameters are removed;
+        // folded parameters are not reported
+        report validate(std::unordered_map<std::string, std::string> &configuration, bool complete) const;
+
+        virtual void print(std::ostream &stream);
+
+        // versioned description of the table, as JSON or in a compact binary
+        // form (see the README for the layout)
+        void write_json(std::ostream &stream) const;
+
+        void write_binary(std::ostream &stream) const;
+
+    protected:
+        friend class basic_configuration<parameter_space>;
+
+        std::string fmt_rule_name(const std::string &path);
+
+        // the condition is returned as parent=value
+        std::string fmt_rule_cond(const std::string &path, const std::string &node_name, int rec_index = -1);
+
+        void fmt_parameter(const std::string &rule_name, const std::string &rule_type,
+                           const std::vector<std::string> &values, std::string default_value, bool log_scale,
+                           std::string rule_cond);
+
+        void merge(parameter_space &worker);
+
+    private:
+        std::vector<parameter> table_;
+        std::unordered_map<std::string, int> index_;
+        std::vector<std::string> pending_parents_;
+        std::unordered_set<std::string> folded_names_;
+
+        bool in_domain(const parameter &param, const std::string &value) const;
+
+        int value_index(const parameter &param, const std::string &value) const;
     };
 
 }
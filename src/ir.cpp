@@ -0,0 +1,121 @@
+//
+//  ir.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+
+#include <cstring>
+
+grammar::ir::ir(const pugi::xml_document& grammar)
+{
+    std::vector<std::vector<unsigned>> definitions;
+    for (auto& block : grammar.child("gr:grammar").children("gr:derivations")) {
+        for (auto& derivation : block.children()) {
+            if (derivation.type() != pugi::node_element) {
+                continue;
+            }
+            unsigned id = lower(derivation);
+            derivation_ids_[derivation.internal_object()] = id;
+            if (nodes_[id].name >= definitions.size()) {
+                definitions.resize(nodes_[id].name + 1);
+            }
+            definitions[nodes_[id].name].push_back(id);
+            if (derivation.attribute("output")) {
+                roots_.push_back(id);
+            }
+        }
+    }
+    rules_.resize(names_.size(), slice{0, 0});
+    for (unsigned name = 0; name < definitions.size(); ++name) {
+        rules_[name] = slice{static_cast<unsigned>(definitions_.size()), static_cast<unsigned>(definitions[name].size())};
+        definitions_.insert(definitions_.end(), definitions[name].begin(), definitions[name].end());
+    }
+}
+
+grammar::ir::kind grammar::ir::classify(const pugi::xml_node& node)
+{
+    bool children = node.children().begin() != node.children().end();
+    bool attributes = node.attributes().begin() != node.attributes().end();
+    if (!children && !attributes && strcmp(node.name(), "or") && node.type() != pugi::node_cdata) {
+        return kind::call;
+    } else if (!children && attributes && strcmp(node.attribute("type").value(), "")) {
+        return kind::range;
+    } else if (!strcmp(node.name(), "gr:copy")) {
+        return kind::copy;
+    } else if (node.type() == pugi::node_cdata) {
+        return kind::cdata;
+    } else if (children) {
+        for (auto& child : node.children()) {
+            if (!strcmp(child.name(), node.name())) {
+                return kind::recursive;
+            }
+        }
+    }
+    // checking if there are choices
+    for (auto& child : node.children()) {
+        if (!strcmp(child.name(), "or")) {
+            return kind::categorical;
+        }
+    }
+    return kind::plain;
+}
+
+unsigned grammar::ir::id(const pugi::xml_node& derivation) const
+{
+    auto it = derivation_ids_.find(derivation.internal_object());
+    if (it == derivation_ids_.end()) {
+        Error::fatal("No derivation " + std::string(derivation.name()) + " in the lowered grammar.");
+    }
+    return it->second;
+}
+
+unsigned grammar::ir::intern(const char* name)
+{
+    auto it = name_ids_.find(name);
+    if (it != name_ids_.end()) {
+        return it->second;
+    }
+    unsigned id = static_cast<unsigned>(names_.size());
+    names_.push_back(name);
+    name_ids_[name] = id;
+    return id;
+}
+
+unsigned grammar::ir::lower(const pugi::xml_node& xml)
+{
+    unsigned id = static_cast<unsigned>(nodes_.size());
+    nodes_.push_back(node{classify(xml), intern(xml.name()), slice{0, 0}, slice{0, 0}, xml});
+    kind type = nodes_[id].type;
+    if (type == kind::cdata) {
+        std::string text = xml.value();
+        nodes_[id].text = slice{static_cast<unsigned>(arena_.size()), static_cast<unsigned>(text.size())};
+        arena_ += text;
+        arena_ += '\0';
+    } else if (type == kind::categorical || type == kind::recursive || type == kind::plain) {
+        // the children are lowered first, so that the ones of each
+        // alternative end up contiguous
+        std::vector<std::vector<unsigned>> choices(1);
+        for (auto& child : xml.children()) {
+            if (!strcmp(child.name(), "or")) {
+                choices.push_back(std::vector<unsigned>());
+            } else {
+                choices.back().push_back(lower(child));
+            }
+        }
+        nodes_[id].alternatives = slice{static_cast<unsigned>(alternatives_.size()), static_cast<unsigned>(choices.size())};
+        for (auto& choice : choices) {
+            alternative current{slice{static_cast<unsigned>(children_.size()), static_cast<unsigned>(choice.size())}, false};
+            for (auto child : choice) {
+                children_.push_back(child);
+                current.recursive = current.recursive || nodes_[child].name == nodes_[id].name;
+            }
+            alternatives_.push_back(current);
+        }
+    }
+    return id;
+}
@@ -10,6 +10,7 @@
 //
 
 #include "grammar.hpp"
+#include "basic_configuration.hpp"
 #include "error.hpp"
 
 #include <boost/algorithm/string/join.hpp>
@@ -48,8 +49,13 @@ void grammar::irace_conf::fmt_parameter(const std::string& rule_name, const std:
         type = "c";
     } else if (rule_type == "recursive") {
         type = "c";
+    } else if (rule_type == "ordinal") {
+        type = "o";
     }
     
     std::string alternatives = boost::join(values, ", ");
     parameters_.push_back(rule_name + " " + type + " (" + alternatives + ")" + rule_cond);
 }
+
+template class grammar::basic_walker<grammar::irace_conf>;
+template class grammar::basic_configuration<grammar::irace_conf>;
@@ -10,8 +10,10 @@
 //
 
 #include <unordered_map>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 
 #include <boost/algorithm/string.hpp>
@@ -20,6 +22,9 @@
 
 #include "grammar.hpp"
 #include "error.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "workers.hpp"
 
 void splash()
 {
@@ -78,8 +83,16 @@ void help(std::string prg_name, boost::program_options::options_description desc
     std::cout << "generation of the code can not be specified at the same time.\n"  << std::endl;
     std::cout << "Examples: " << std::endl;
     std::cout << "  " << prg_name << " grammar.xml [-o test.xml] [-d 5] [-f irace] -p parameters.txt" << std::endl;
+    std::cout << "  " << prg_name << " grammar.xml [-o test.xml] [-d 5] --count" << std::endl;
+    std::cout << "  " << prg_name << " grammar.xml [-o test.xml] [-d 5] --sample 100 [--seed 1] [-p candidates.txt]" << std::endl;
+    std::cout << "  " << prg_name << " grammar.xml [-o test.xml] [-d 5] --enumerate [--partition 1/4] [-p candidates.txt]" << std::endl;
+    std::cout << "  " << prg_name << " grammar.xml [-o test.xml] [-d 5] --export_space space.json" << std::endl;
+    std::cout << "  " << prg_name << " grammar.xml [-o test.xml] [-d 5] --validate [--complete] \\" << std::endl;
+    std::cout << "               --parameter1=value1 [--parameter2=value2 ...]" << std::endl;
     std::cout << "  " << prg_name << " grammar.xml [-o test.xml] -t src_code [-x] \\" << std::endl;
-    std::cout << "               --parameter1=value1 [--parameter2=value2 ...]\n" << std::endl;
+    std::cout << "               --parameter1=value1 [--parameter2=value2 ...]" << std::endl;
+    std::cout << "  " << prg_name << " grammar.xml [-o test.xml] -t src_code [-x] -b candidates.txt" << std::endl;
+    std::cout << "  " << prg_name << " grammar.xml [-o test.xml] --compile_generator generator.cpp\n" << std::endl;
 }
 
 void define_options(boost::program_options::options_description& desc_full,
@@ -91,19 +104,44 @@ void define_options(boost::program_options::options_description& desc_full,
         ("help,h", "this help message and some examples")
         ("version,v", "prints the version and license")
         ("overwrite,o", boost::program_options::value<std::string>(), "optional xml file with derivations that overwrite parts of the original grammar")
+        ("stats", boost::program_options::value<std::string>()->implicit_value("-"), "write the wall time and the peak memory of each phase, and some counters, as JSON at exit on the standard error (or in the file given with --stats=file)")
+        ("trace", boost::program_options::value<std::string>(), "write the phases, the derivations walked and the output files written to file as Chrome trace events")
+        ("jobs,j", boost::program_options::value<int>()->default_value(1), "threads walking the derivations with the output attribute at the same time (0 for one per core)")
     ;
 
     boost::program_options::options_description desc_pars("Options for generating the parameters");
     desc_pars.add_options()
         ("depth,d", boost::program_options::value<int>()->default_value(3), "maximum recursion depth")
-        ("params_format,f", boost::program_options::value<std::string>()->default_value("irace"), "format: 'irace', 'ParamILS', 'SMAC', 'crace' or 'emili' ")
+        ("params_format,f", boost::program_options::value<std::string>()->default_value("irace"), "format: 'irace', 'ParamILS', 'SMAC', 'crace' or 'emili', or a comma-separated list of them written from a single walk, each to its own parameters file (name.format.ext)")
         ("parameters,p", boost::program_options::value<std::string>(), "save generated parameters to file")
+        ("recursion_count", boost::program_options::bool_switch()->default_value(false), "encode each list-like recursion with a single ordinal parameter counting its repetitions, instead of one parameter per level")
+        ("keep_degenerate", boost::program_options::bool_switch()->default_value(false), "keep the parameters with a single value (ranges with min equal to max, last levels of the recursions), which are otherwise left out as constants")
+        ("count", boost::program_options::bool_switch()->default_value(false), "print the number of distinct derivations up to the maximum recursion depth")
+        ("sample", boost::program_options::value<long>(), "draw configurations uniformly over the derivations up to the maximum recursion depth, and save them to the parameters file if given")
+        ("seed", boost::program_options::value<unsigned long>(), "seed of the sampler (default random)")
+        ("weights", boost::program_options::value<std::string>(), "file with the weights of the alternatives of the rules for the sampler (rule w0 w1 ...)")
+        ("enumerate", boost::program_options::bool_switch()->default_value(false), "enumerate the configurations up to the maximum recursion depth in a canonical order, and save them to the parameters file if given")
+        ("partition", boost::program_options::value<std::string>(), "enumerate only the k-th of K equal parts of the configurations (k/K)")
+        ("from", boost::program_options::value<std::string>(), "index of the first configuration to enumerate")
+        ("limit", boost::program_options::value<long>(), "maximum number of configurations to enumerate")
+        ("validate", boost::program_options::bool_switch()->default_value(false), "check that the parameters passed form a valid configuration up to the maximum recursion depth")
+        ("export_space", boost::program_options::value<std::string>(), "save the parameters, their domains and conditions up to the maximum recursion depth to file (JSON if the extension is .json, binary otherwise)")
+        ("complete", boost::program_options::bool_switch()->default_value(false), "along with --validate, print the configuration with the missing parameters set to their default and without the inactive and unknown ones")
     ;
 
     boost::program_options::options_description desc_code("Options for generating the code");
     desc_code.add_options()
         ("do_not_reindent,x", boost::program_options::bool_switch()->default_value(false), "do not re-indent the geneated code")
         ("target_dir,t", boost::program_options::value<std::string>(), "target directory for the geneated code")
+        ("superset", boost::program_options::bool_switch()->default_value(false), "generate a single program for all the configurations up to the maximum recursion depth, which reads the parameters at runtime")
+        ("batch,b", boost::program_options::value<std::string>(), "file with one candidate per line (id --parameter1=value1 ...), the code of each candidate is generated in target_dir/id")
+        ("invariant_dir", boost::program_options::value<std::string>(), "directory where the code shared by all the candidates is written once and included by the C/C++ output files")
+        ("ninja,n", boost::program_options::bool_switch()->default_value(false), "emit a unity source and a ninja build file along with the generated code")
+        ("compiler", boost::program_options::value<std::string>()->default_value(""), "compiler used in the ninja build files (default cc or c++)")
+        ("compiler_flags", boost::program_options::value<std::vector<std::string>>()->composing()->default_value(std::vector<std::string>(1, "-O2"), "-O2"), "compiler flags used in the ninja build files, also once for each of them (e.g. --compiler_flags=-O2 --compiler_flags=-g)")
+        ("linker_flags", boost::program_options::value<std::vector<std::string>>()->composing(), "linker flag or library used in the ninja build files, once for each of them (e.g. --linker_flags=-lm)")
+        ("executable", boost::program_options::value<std::string>()->default_value("candidate"), "name of the executable built by the ninja build files")
+        ("compile_generator", boost::program_options::value<std::string>(), "write the C++17 source of a standalone generator for the grammar, which takes the same parameters as -t")
     ;
 
     positional.add("grammar", 1);
@@ -122,19 +160,27 @@ void cleanup_parameters(std::vector<std::string>& args, int argc, const char * a
 {
     // we clean up the parameters passed since --parameter= 1 are not easily
     // parsed by boost program_options, so we remove all white space around
-    // the equal symbols (this should not impact on any parameter)
-    std::vector<std::string> s_argv(argv, argv + argc);
-    std::string parameters = boost::algorithm::join(s_argv, " ");
-    parameters = boost::algorithm::replace_all_copy(parameters, " =", "=");
-    parameters = boost::algorithm::replace_all_copy(parameters, "= ", "=");
-    boost::split(args, parameters, boost::is_any_of(" "));
-    args.erase(args.begin());
+    // the equal symbols (this should not impact on any parameter); the
+    // arguments are otherwise kept whole, so that a quoted value such as
+    // --compiler_flags "-O2 -g" is not split
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        arg = boost::algorithm::replace_all_copy(arg, " =", "=");
+        arg = boost::algorithm::replace_all_copy(arg, "= ", "=");
+        if (!args.empty() && !arg.empty() && (boost::ends_with(args.back(), "=") || boost::starts_with(arg, "="))) {
+            args.back() += arg;
+        } else {
+            args.push_back(arg);
+        }
+    }
 }
 
 void parse_grammar_parameters(std::unordered_map<std::string, std::string>& grammar_parameters,
-                              std::vector<std::string>& further_parameters)
+                              std::vector<std::string>& further_parameters, bool verbose = true)
 {
-    std::cout << "\x1B[33mparameters for the code generation\x1B[m\n" << std::endl;
+    if (verbose) {
+        std::cout << "\x1B[33mparameters for the code generation\x1B[m\n" << std::endl;
+    }
     std::string name = "";
     std::string value = "";
     for (auto it = further_parameters.begin() ; it != further_parameters.end(); ++it) {
@@ -152,11 +198,122 @@ void parse_grammar_parameters(std::unordered_map<std::string, std::string>& gram
             // parameter without dashes or something went wrong previously
             Error::fatal("Cannot parse parameter " + *it + ".");
         }
-        std::cerr << name << " : " << value << std::endl;
+        if (verbose) {
+            std::cerr << name << " : " << value << std::endl;
+        }
         grammar_parameters[name] = value;
     }
 }
 
+// writes the parameters of the last walk of the configuration, emili also
+// writes the code of its classes
+void save_parameters(grammar::configuration& configuration, const std::string& format, const boost::filesystem::path& param_file)
+{
+    std::ofstream par_file(param_file.string());
+    if (!par_file.good()) {
+        Error::fatal("Could not open " + param_file.string() + ".");
+    }
+    configuration.write(par_file);
+    if (format == "emili") {
+        configuration.printToFile(param_file.string());
+    }
+    par_file.close();
+}
+
+void open_candidates_file(boost::program_options::variables_map& vm, std::ofstream& par_file)
+{
+    if (vm.count("parameters") != 0) {
+        par_file.open(vm["parameters"].as<std::string>());
+        if (!par_file.good()) {
+            Error::fatal("Could not open " + vm["parameters"].as<std::string>() + ".");
+        }
+    }
+}
+
+// one candidate per line as in the batch files
+void print_candidate(std::ofstream& par_file, const std::string& id,
+                     const std::vector<std::pair<std::string, std::string>>& assignment)
+{
+    std::ostringstream line;
+    line << id;
+    for (auto& param : assignment) {
+        line << " --" << param.first << "=" << param.second;
+    }
+    std::cout << line.str() << '\n';
+    if (par_file.is_open()) {
+        par_file << line.str() << '\n';
+    }
+}
+
+std::shared_ptr<grammar::build_graph> build_graph(boost::program_options::variables_map& vm)
+{
+    std::shared_ptr<grammar::build_graph> graph;
+    std::string compiler_flags = boost::algorithm::join(vm["compiler_flags"].as<std::vector<std::string>>(), " ");
+    std::string linker_flags;
+    if (vm.count("linker_flags") != 0) {
+        linker_flags = boost::algorithm::join(vm["linker_flags"].as<std::vector<std::string>>(), " ");
+    }
+    if (vm["ninja"].as<bool>()) {
+        graph = std::make_shared<grammar::build_graph>(vm["compiler"].as<std::string>(),
+                                                       compiler_flags,
+                                                       linker_flags,
+                                                       vm["executable"].as<std::string>());
+    }
+    return graph;
+}
+
+void generate_batch(std::shared_ptr<grammar::model>& ruleset, boost::filesystem::path batch_file,
+                    boost::filesystem::path target_dir, int depth, bool do_not_reindent,
+                    boost::filesystem::path invariant_dir, std::shared_ptr<grammar::build_graph> graph)
+{
+    std::ifstream candidates(batch_file.string());
+    if (!candidates.good()) {
+        Error::fatal("Could not open " + batch_file.string() + ".");
+    }
+
+    // the generated code is not echoed for each candidate, a stream without
+    // buffer discards everything written to it
+    std::ostream null_stream(nullptr);
+    std::shared_ptr<grammar::code_cache> cache = std::make_shared<grammar::code_cache>();
+    std::string line;
+    int count = 0;
+    while (getline(candidates, line)) {
+        // same clean up of the spaces around the equal symbols done for the
+        // command line parameters
+        line = boost::algorithm::replace_all_copy(line, " =", "=");
+        line = boost::algorithm::replace_all_copy(line, "= ", "=");
+        std::vector<std::string> tokens;
+        boost::split(tokens, line, boost::is_any_of(" \t"), boost::token_compress_on);
+        tokens.erase(std::remove(tokens.begin(), tokens.end(), ""), tokens.end());
+        if (tokens.empty() || boost::starts_with(tokens[0], "#")) {
+            continue;
+        }
+        std::string id = tokens[0];
+        tokens.erase(tokens.begin());
+        if (tokens.empty()) {
+            Error::fatal("No parameters found for candidate " + id + ".");
+        }
+
+        std::unordered_map<std::string, std::string> grammar_parameters;
+        parse_grammar_parameters(grammar_parameters, tokens, false);
+        std::cout << "Candidate " << id << ": " << (target_dir / id) << std::endl;
+        grammar::params2code p2c(ruleset, grammar_parameters, target_dir / id, null_stream, do_not_reindent);
+        p2c.set_max_depth(depth);
+        p2c.set_cache(cache);
+        p2c.set_invariant_dir(invariant_dir);
+        p2c.generate_code();
+        if (graph) {
+            graph->add_candidate(target_dir / id, p2c.generated_files());
+        }
+        ++count;
+    }
+    if (graph) {
+        graph->write_batch(target_dir);
+    }
+    std::cout << "\nGenerated " << count << " candidates (output files cache: " << cache->hits() << " hits, ";
+    std::cout << cache->misses() << " misses)." << std::endl;
+}
+
 
 int main(int argc, const char * argv[])
 {
@@ -192,8 +349,15 @@ int main(int argc, const char * argv[])
         return EXIT_SUCCESS;
     }
 
-    // positional and non-optional parameters (no grammar or no (parameters XOR target_dir)
-    if (vm.count("grammar") == 0 || !((vm.count("parameters") != 0) != (vm.count("target_dir") != 0))) {
+    // positional and non-optional parameters (no grammar or not exactly one
+    // among parameters, target_dir, compile_generator, count, sample,
+    // enumerate, validate and export_space; the parameters file is also
+    // where the configurations sampled or enumerated are saved)
+    bool candidates = vm.count("sample") != 0 || vm["enumerate"].as<bool>();
+    int modes = (vm.count("parameters") != 0 && !candidates) + (vm.count("target_dir") != 0)
+                + (vm.count("compile_generator") != 0) + vm["count"].as<bool>() + (vm.count("sample") != 0)
+                + vm["enumerate"].as<bool>() + vm["validate"].as<bool>() + (vm.count("export_space") != 0);
+    if (vm.count("grammar") == 0 || modes != 1) {
         usage(prg_name, desc_visible);
         return EXIT_FAILURE;
     }
@@ -204,55 +368,100 @@ int main(int argc, const char * argv[])
     if (vm.count("overwrite") != 0) {
         overwrite_xml = vm["overwrite"].as<std::string>();
     }
+    if (vm.count("stats") != 0) {
+        Stats::enable(vm["stats"].as<std::string>());
+    }
+    if (vm.count("trace") != 0) {
+        Trace::enable(vm["trace"].as<std::string>());
+    }
+    Workers::set_jobs(vm["jobs"].as<int>());
     std::shared_ptr<grammar::model> ruleset = std::make_shared<grammar::model>(grammar_xml, overwrite_xml);
+    Stats::phase("print_grammar");
     std::cout << "\n\x1B[33mcleaned up grammar\x1B[m\n" << std::endl;
     ruleset->grammar().print(std::cout);
     std::cout << std::endl;
 
-    if (vm.count("parameters") != 0) {
+    if (vm.count("parameters") != 0 && !candidates) {
+        Stats::phase("parameters");
         // generating list of parameters
         int depth = vm["depth"].as<int>();
-        std::string format = vm["params_format"].as<std::string>();
-        boost::algorithm::to_lower(format);
-        std::shared_ptr<grammar::configuration> configuration;
-        if (format == "irace") {
-            configuration = std::make_shared<grammar::irace_conf>(ruleset, depth);
-        } else if (format == "paramils") {
-            configuration = std::make_shared<grammar::paramils_conf>(ruleset, depth);
-        } else if (format == "smac") {
-            configuration = std::make_shared<grammar::smac_conf>(ruleset, depth);
-        } else if (format == "emili") {
-            configuration = std::make_shared<grammar::emili_conf>(ruleset, depth);
-        }else if (format == "crace") {
-            configuration = std::make_shared<grammar::crace_conf>(ruleset, depth);
-        } else {
-            Error::fatal("Unrecognized file format " + vm["params_format"].as<std::string>() + ".");
+        std::vector<std::string> formats;
+        boost::split(formats, vm["params_format"].as<std::string>(), boost::is_any_of(","));
+        std::vector<std::shared_ptr<grammar::configuration>> configurations;
+        for (size_t i = 0; i < formats.size(); ++i) {
+            boost::algorithm::to_lower(formats[i]);
+            if (std::find(formats.begin(), formats.begin() + i, formats[i]) != formats.begin() + i) {
+                Error::fatal("Format " + formats[i] + " given twice.");
+            }
+            configurations.push_back(grammar::configuration::make(formats[i], ruleset, depth));
+            configurations.back()->set_recursion_count(vm["recursion_count"].as<bool>());
+            configurations.back()->set_keep_degenerate(vm["keep_degenerate"].as<bool>());
         }
-        std::cout << "\n\x1B[33m" << vm["params_format"].as<std::string>() << " parameters\x1B[m\n" << std::endl;
-        configuration->print(std::cout);
-        std::cout << std::endl;
-
-        // saving parameters to file
         boost::filesystem::path parameters(vm["parameters"].as<std::string>());
-        boost::filesystem::path param_file = parameters;
-        std::ofstream par_file(param_file.string());
-        if (par_file.good()) {
-            if(format == "emili")
-            {
-                configuration->print(par_file);
-                configuration->printToFile(param_file.string());
+        if (configurations.size() == 1) {
+            std::cout << "\n\x1B[33m" << vm["params_format"].as<std::string>() << " parameters\x1B[m\n" << std::endl;
+            configurations[0]->print(std::cout);
+            std::cout << std::endl;
+            save_parameters(*configurations[0], formats[0], parameters);
+        } else {
+            // a single walk for all the formats, each saved in its own file
+            grammar::emitter emitter(ruleset, depth);
+            for (auto& configuration : configurations) {
+                emitter.add(configuration);
             }
-            else
-            {
-                configuration->print(par_file);
+            emitter.walk();
+            for (size_t i = 0; i < formats.size(); ++i) {
+                std::cout << "\n\x1B[33m" << formats[i] << " parameters\x1B[m\n" << std::endl;
+                configurations[i]->write(std::cout);
+                std::cout << std::endl;
+                boost::filesystem::path param_file = parameters.parent_path() / (parameters.stem().string() + "." + formats[i] + parameters.extension().string());
+                save_parameters(*configurations[i], formats[i], param_file);
             }
-        } else {
-            Error::fatal("Could not open " + parameters.string() + ".");
         }
-        par_file.close();
     }
 
-    if (vm.count("target_dir") != 0) {
+    if (vm.count("target_dir") != 0 && vm.count("batch") != 0) {
+        Stats::phase("batch");
+        boost::filesystem::path target_dir(vm["target_dir"].as<std::string>());
+
+        // the parameters of each candidate are in the batch file
+        if (further_parameters.size() > 1) {
+            Error::fatal("Parameters for generating the code cannot be passed along with a batch file.");
+        }
+
+        std::cout << "\n\x1B[33mgenerating code for a batch of candidates\x1B[m\n" << std::endl;
+        std::cout << "Target directory: " << target_dir << "\n" << std::endl;
+        bool do_not_Reindent = vm["do_not_reindent"].as<bool>();
+
+        boost::filesystem::path invariant_dir;
+        if (vm.count("invariant_dir") != 0) {
+            invariant_dir = vm["invariant_dir"].as<std::string>();
+        }
+
+        generate_batch(ruleset, vm["batch"].as<std::string>(), target_dir, vm["depth"].as<int>(), do_not_Reindent, invariant_dir, build_graph(vm));
+        std::cout << std::endl;
+    } else if (vm.count("target_dir") != 0 && vm["superset"].as<bool>()) {
+        Stats::phase("superset");
+        boost::filesystem::path target_dir(vm["target_dir"].as<std::string>());
+
+        // the parameters are read at runtime by the generated program
+        if (further_parameters.size() > 1) {
+            Error::fatal("Parameters for generating the code cannot be passed along with --superset.");
+        }
+
+        std::cout << "\n\x1B[33mgenerating code for all the configurations\x1B[m\n" << std::endl;
+        std::cout << "Target directory: " << target_dir << "\n" << std::endl;
+        bool do_not_Reindent = vm["do_not_reindent"].as<bool>();
+
+        grammar::superset_code superset(ruleset, vm["depth"].as<int>(), target_dir, std::cout, do_not_Reindent);
+        superset.generate_code();
+        std::shared_ptr<grammar::build_graph> graph = build_graph(vm);
+        if (graph) {
+            graph->add_candidate(target_dir, superset.generated_files());
+        }
+        std::cout << std::endl;
+    } else if (vm.count("target_dir") != 0) {
+        Stats::phase("generate");
         boost::filesystem::path target_dir(vm["target_dir"].as<std::string>());
 
         // check if there are further parameters to transfortm the grammar into code
@@ -274,8 +483,153 @@ int main(int argc, const char * argv[])
         bool do_not_Reindent = vm["do_not_reindent"].as<bool>();
 
         grammar::params2code p2c(ruleset, grammar_parameters, target_dir, std::cout, do_not_Reindent);
+        p2c.set_max_depth(vm["depth"].as<int>());
+        if (vm.count("invariant_dir") != 0) {
+            p2c.set_invariant_dir(vm["invariant_dir"].as<std::string>());
+        }
         p2c.generate_code();
+        std::shared_ptr<grammar::build_graph> graph = build_graph(vm);
+        if (graph) {
+            graph->add_candidate(target_dir, p2c.generated_files());
+        }
         std::cout << std::endl;
+    } else if (vm.count("compile_generator") != 0) {
+        Stats::phase("compile_generator");
+        boost::filesystem::path generator(vm["compile_generator"].as<std::string>());
+        std::ofstream fout(generator.string());
+        if (!fout.good()) {
+            Error::fatal("Could not write " + generator.string() + ".");
+        }
+        std::cout << "\n\x1B[33mcompiling generator\x1B[m\n" << std::endl;
+        grammar::generator_compiler compiler(ruleset);
+        compiler.compile(fout);
+        fout.close();
+        std::cout << "Generator source written to " << generator << "." << std::endl;
+    } else if (vm["count"].as<bool>()) {
+        Stats::phase("count");
+        std::cout << "\n\x1B[33mcounting derivations\x1B[m\n" << std::endl;
+        grammar::design_space space(ruleset, vm["depth"].as<int>());
+        space.print(std::cout);
+    } else if (vm.count("sample") != 0) {
+        Stats::phase("sample");
+        unsigned long seed = vm.count("seed") != 0 ? vm["seed"].as<unsigned long>() : std::random_device()();
+        grammar::sampler sampler(ruleset, vm["depth"].as<int>(), seed);
+        sampler.set_recursion_count(vm["recursion_count"].as<bool>());
+        sampler.set_keep_degenerate(vm["keep_degenerate"].as<bool>());
+        if (vm.count("weights") != 0) {
+            sampler.load_weights(vm["weights"].as<std::string>());
+        }
+        std::ofstream par_file;
+        open_candidates_file(vm, par_file);
+        std::cout << "\n\x1B[33msampled configurations (seed " << seed << ")\x1B[m\n" << std::endl;
+        long samples = vm["sample"].as<long>();
+        for (long i = 1; i <= samples; ++i) {
+            print_candidate(par_file, std::to_string(i), sampler.sample());
+        }
+    } else if (vm["enumerate"].as<bool>()) {
+        Stats::phase("enumerate");
+        grammar::enumerator enumerator(ruleset, vm["depth"].as<int>());
+        enumerator.set_recursion_count(vm["recursion_count"].as<bool>());
+        enumerator.set_keep_degenerate(vm["keep_degenerate"].as<bool>());
+        boost::multiprecision::cpp_int total = enumerator.count();
+        boost::multiprecision::cpp_int begin = 0;
+        boost::multiprecision::cpp_int end = total;
+        if (vm.count("partition") != 0) {
+            std::vector<std::string> tokens;
+            boost::split(tokens, vm["partition"].as<std::string>(), boost::is_any_of("/"));
+            long k = 0;
+            long partitions = 0;
+            try {
+                size_t parsed_k = 0;
+                size_t parsed_partitions = 0;
+                if (tokens.size() == 2) {
+                    k = std::stol(tokens[0], &parsed_k);
+                    partitions = std::stol(tokens[1], &parsed_partitions);
+                    if (parsed_k != tokens[0].size() || parsed_partitions != tokens[1].size()) {
+                        k = 0;
+                    }
+                }
+            } catch (const std::exception&) {
+                // not a number, or out of the range of long
+                k = 0;
+            }
+            if (k < 1 || k > partitions) {
+                Error::fatal("Partition " + vm["partition"].as<std::string>() + " is not in the form k/K with 1 <= k <= K.");
+            }
+            begin = total * (k - 1) / partitions;
+            end = total * k / partitions;
+        }
+        if (vm.count("from") != 0) {
+            boost::multiprecision::cpp_int from;
+            try {
+                from = boost::multiprecision::cpp_int(vm["from"].as<std::string>());
+            } catch (const std::exception&) {
+                Error::fatal("Index " + vm["from"].as<std::string>() + " passed with --from is not an integer.");
+            }
+            begin = std::max(begin, from);
+        }
+        if (vm.count("limit") != 0) {
+            end = std::min(end, boost::multiprecision::cpp_int(begin + vm["limit"].as<long>()));
+        }
+        enumerator.set_range(begin, end);
+
+        std::ofstream par_file;
+        open_candidates_file(vm, par_file);
+        std::cout << "\n\x1B[33menumerated configurations (" << begin << " to " << end << " of " << total << ")\x1B[m\n" << std::endl;
+        while (enumerator.next()) {
+            std::ostringstream id;
+            id << enumerator.cursor() - 1;
+            print_candidate(par_file, id.str(), enumerator.assignment());
+        }
+        std::cout << "\nNext configuration: " << enumerator.cursor() << std::endl;
+    } else if (vm["validate"].as<bool>()) {
+        Stats::phase("validate");
+        std::unordered_map<std::string, std::string> grammar_parameters;
+        if (further_parameters.empty() || further_parameters[0] != vm["grammar"].as<std::string>()) {
+            Error::fatal("First positional parameter does not correspond to the grammar.");
+        }
+        further_parameters.erase(further_parameters.begin());
+        parse_grammar_parameters(grammar_parameters, further_parameters, false);
+
+        grammar::parameter_space space(ruleset, vm["depth"].as<int>(), vm["keep_degenerate"].as<bool>(), vm["recursion_count"].as<bool>());
+        bool complete = vm["complete"].as<bool>();
+        auto report = space.validate(grammar_parameters, complete);
+        std::cout << "\n\x1B[33mvalidating configuration\x1B[m\n" << std::endl;
+        report.print(std::cout);
+        if (complete) {
+            // same order of the parameters in the configuration files
+            std::cout << std::endl;
+            for (auto& param : space.parameters()) {
+                auto value = grammar_parameters.find(param.name);
+                if (value != grammar_parameters.end()) {
+                    std::cout << "--" << param.name << "=" << value->second << " ";
+                }
+            }
+            std::cout << std::endl;
+            if (!report.out_of_range.empty()) {
+                return EXIT_FAILURE;
+            }
+        } else if (!report.valid()) {
+            return EXIT_FAILURE;
+        }
+        std::cout << "Valid configuration." << std::endl;
+    } else if (vm.count("export_space") != 0) {
+        Stats::phase("export_space");
+        boost::filesystem::path space_file(vm["export_space"].as<std::string>());
+        grammar::parameter_space space(ruleset, vm["depth"].as<int>(), vm["keep_degenerate"].as<bool>(), vm["recursion_count"].as<bool>());
+        std::cout << "\n\x1B[33mparameter space\x1B[m\n" << std::endl;
+        space.print(std::cout);
+        bool json = boost::iequals(space_file.extension().string(), ".json");
+        std::ofstream fout(space_file.string(), json ? std::ios::out : std::ios::out | std::ios::binary);
+        if (!fout.good()) {
+            Error::fatal("Could not open " + space_file.string() + ".");
+        }
+        if (json) {
+            space.write_json(fout);
+        } else {
+            space.write_binary(fout);
+        }
+        fout.close();
     }
 
     return EXIT_SUCCESS;
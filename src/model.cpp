@@ -11,6 +11,7 @@
 
 #include "grammar.hpp"
 #include "error.hpp"
+#include "stats.hpp"
 
 #include <boost/filesystem.hpp>
 
@@ -21,26 +22,36 @@
 grammar::model::model(boost::filesystem::path xml_file,
                       boost::filesystem::path overwrite_xml_file)
 {
+    Stats::phase("parse");
     parse_and_merge_grammars(xml_file);
+    Stats::phase("overwrite_derivations");
     overwrite_derivations(overwrite_xml_file);
     
     // merging rules from diffrent grammars
+    Stats::phase("clean_up_append_disjunctions");
     clean_up_append_disjuncitons();
     
     // there can be empty cdata around
+    Stats::phase("clean_up_remove_empty_cdatas");
     clean_up_remove_empty_cdatas();
     
     // there can be temporary empty derivations or that had empty CDATAs
+    Stats::phase("clean_up_remove_empty_derivations");
     clean_up_remove_empty_derivations();
     
     // after removing empty derivations there could be adjacent ORs or rules
     // that begin or end with an OR
+    Stats::phase("clean_up_remove_useless_ors");
     clean_up_remove_useless_ors();
     
     // preprocessing the simplest case here in which a rule like A ::= B | BA
     // can be simplified to BA (where A is used) and A ::= [] | BA. Doing this
     // will reduce the number of actual parameters generated.
-    // Complex cases like A ::= CB | DBA are not simplified.
+    // The same is done for any sequences in place of B, and for the other
+    // regular recursions: A ::= CB | DBA becomes A ::= [] | DBA and is used
+    // as A CB, while A ::= S | AQ becomes A ::= [] | QA and is used as S A.
+    // Recursions with something both before and after the recursive call,
+    // as in A ::= S | PAQ, are not simplified.
     //
     // Typical example is:                          That expands to:
     //
@@ -91,44 +102,52 @@ grammar::model::model(boost::filesystem::path xml_file,
     // detected it is replaced by A :== [] | BA and wherever A is used in the
     // grammar it becomes a BA.
     //
-    // The function works whetever B has no children or is a CDATA (and the
-    // CDATA on the left and right of the OR are identical).
+    // The function works whetever the nodes of the alternatives have no
+    // children or are CDATAs.
     //
     // This preprocessing step should be done before clean_up_remove_non_choices
     // that could make the original recursive rule more complex and cannot be
     // detected anymore
+    Stats::phase("clean_up_simplify_recursions");
     clean_up_simplify_recursions();
 
     // NOTE in the first implementation there was also a function for
     //      concatenating rules, don't remember for which case it was useful
     //      since we already remove non choices
     // some rules represent no choice, their content is copied where used
+    Stats::phase("clean_up_remove_non_choices");
     clean_up_remove_non_choices();
 
     // rules like A ::= B | C | D where C ::= E | F, can be merged together to
     // reduce the number of parameters generated, i.e., A :: = B | E | F | D
-    // TODO: this can be furhter extended to the cases where A ::= B | zC | D
-    //       where one has to pay attention and A :: = B | zE | zF | D prepend
-    //       the terminal suffix z to all alternatives, this could get quickly
-    //       more complicate to cases where z is actually a Z and or a sequence
-    //       of terminal and non terminal as prefix and suffix
+    // this is also done when C is surrounded by terminals, e.g.,
+    // A ::= B | yCz | D becomes A ::= B | yEz | yFz | D, where the terminal
+    // prefix y and suffix z are copied in all alternatives
+    // prefixes and suffixes with non terminals are left as they are, since
+    // each copy of a non terminal would be walked as a parameter of its own,
+    // and the merge would generate more parameters than it removes
+    Stats::phase("clean_up_merge_disjunctions");
     clean_up_merge_disjuncitons();
     
     // some rules can be duplicates
     // (this was more useful in the original python code where the code was
     //  duplicated for the group IDs)
+    Stats::phase("clean_up_remove_duplicates");
     clean_up_remove_duplicates();
     
     // rules can be defined and never used
     // (also this was more useful in the original python code where the code was
     //  automatically duplicated for the group IDs)
+    Stats::phase("clean_up_remove_non_used_rules");
     clean_up_remove_non_used_rules();
     
     // just for polishing adjacent CDATAs are merged together
+    Stats::phase("clean_up_merge_cdatas");
     clean_up_merge_cdatas();
     
     // before actually creating some (legitimate) duplicates check if there are
     // already in the simplified grammar
+    Stats::phase("warn_for_duplicate_derivations");
     warn_for_duplicate_derivations();
     
     // once the grammmar is simplified, we possibly rename some rule calls that
@@ -148,7 +167,12 @@ grammar::model::model(boost::filesystem::path xml_file,
     // A :: = BC | B where this is actually a choice and the content of B will
     // be distinguished in the subsequent parameters form the path in the
     // parameter name that will contain the choice made in A
+    Stats::phase("rename_calls");
     rename_calls();
+
+    // the walks do not touch the xml anymore
+    Stats::phase("lower");
+    lowered_ = grammar::ir(grammar_);
 }
 
 pugi::xml_document& grammar::model::grammar()
@@ -161,6 +185,11 @@ boost::filesystem::path grammar::model::grammar_path()
     return base_path_;
 }
 
+const grammar::ir& grammar::model::lowered() const
+{
+    return lowered_;
+}
+
 void grammar::model::load_grammar(boost::filesystem::path filename, pugi::xml_document& document)
 {
     pugi::xml_parse_result result = document.load_file(filename.c_str());
@@ -201,7 +230,7 @@ void grammar::model::parse_and_merge_grammars(boost::filesystem::path xml_file)
     //       the possible duplicate includes and relative paths...
     std::vector<std::shared_ptr<pugi::xml_document>> grammar_files;
     pugi::xpath_query includes("/gr:grammar//gr:include");
-    for (auto& element: includes.evaluate_node_set(grammar_)) {
+    for (auto& element: Stats::xpath(includes).evaluate_node_set(grammar_)) {
         std::string filename = element.node().attribute("source").value();
         std::shared_ptr<pugi::xml_document> grammar = std::make_shared<pugi::xml_document>();
         load_grammar(base_path_ / boost::filesystem::path(filename), *grammar);
@@ -211,11 +240,11 @@ void grammar::model::parse_and_merge_grammars(boost::filesystem::path xml_file)
     
     // merging included files into the main one
     pugi::xpath_query derivations_query("/gr:grammar/gr:derivations");
-    pugi::xml_node derivations = derivations_query.evaluate_node_set(grammar_)[0].node();
+    pugi::xml_node derivations = Stats::xpath(derivations_query).evaluate_node_set(grammar_)[0].node();
     
     pugi::xpath_query all_elements("/gr:grammar/gr:derivations/*");
     for (auto& grammar : grammar_files) {
-        for (auto& element : all_elements.evaluate_node_set(*grammar)) {
+        for (auto& element : Stats::xpath(all_elements).evaluate_node_set(*grammar)) {
             derivations.append_copy(element.node());
         }
     }
@@ -229,14 +258,14 @@ void grammar::model::overwrite_derivations(boost::filesystem::path xml_file)
 
         // replacing derivations in the main grammar
         pugi::xpath_query all_elements("/gr:grammar/gr:derivations/*");
-        for (auto& element : all_elements.evaluate_node_set(overwrite_grammar)) {
+        for (auto& element : Stats::xpath(all_elements).evaluate_node_set(overwrite_grammar)) {
             // looking for the same derivation
             std::string name = element.node().name();
             pugi::xpath_query element_to_replace(("/gr:grammar/gr:derivations/" + name).c_str());
-            if (element_to_replace.evaluate_node_set(grammar_).size() == 0) {
+            if (Stats::xpath(element_to_replace).evaluate_node_set(grammar_).size() == 0) {
                 Error::fatal("No derivation " + name + " to replace.");
             }
-            pugi::xml_node target = element_to_replace.evaluate_node_set(grammar_)[0].node();
+            pugi::xml_node target = Stats::xpath(element_to_replace).evaluate_node_set(grammar_)[0].node();
             target.parent().insert_copy_after(element.node(), target);
             target.parent().remove_child(target);
         }
@@ -253,13 +282,13 @@ void grammar::model::clean_up_append_disjuncitons()
     // NOTE: append=disjunction can be used to merge derivations only and
     //       not any possible node inside the grammar
     pugi::xpath_query elements_to_append("/gr:grammar/gr:derivations/*[@append='disjunction']");
-    for (auto& element : elements_to_append.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(elements_to_append).evaluate_node_set(grammar_)) {
         std::string name = element.node().name();
         pugi::xpath_query element_to_extend(("/gr:grammar/gr:derivations/" + name + "[not(@append)]").c_str());
-        if (element_to_extend.evaluate_node_set(grammar_).size() == 0) {
+        if (Stats::xpath(element_to_extend).evaluate_node_set(grammar_).size() == 0) {
             Error::fatal("No derivation " + name + " to extend.");
         }
-        pugi::xml_node target = element_to_extend.evaluate_node_set(grammar_)[0].node();
+        pugi::xml_node target = Stats::xpath(element_to_extend).evaluate_node_set(grammar_)[0].node();
         target.append_child("or");
         for (auto& child : element.node().children()) {
             target.append_copy(child);
@@ -271,7 +300,7 @@ void grammar::model::clean_up_append_disjuncitons()
 void grammar::model::clean_up_remove_empty_cdatas()
 {
     pugi::xpath_query elements_to_remove("/gr:grammar/gr:derivations/*[text() = '']");
-    for (auto& element : elements_to_remove.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(elements_to_remove).evaluate_node_set(grammar_)) {
         for (auto& child : element.node().children()) {
             if (child.type() == pugi::node_cdata && !strcmp(child.value(), "")) {
                 element.node().remove_child(child);
@@ -284,13 +313,13 @@ void grammar::model::clean_up_remove_empty_derivations()
 {
     pugi::xpath_query elements_to_remove("/gr:grammar/gr:derivations/*[count(*)=0 and count(@*)=0 and not(text())]");
     std::vector<std::string> to_remove;
-    for (auto& element : elements_to_remove.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(elements_to_remove).evaluate_node_set(grammar_)) {
         to_remove.push_back(element.node().name());
     }
     for (auto& name : to_remove) {
         std::cout << "Removing all occurrences of empty rule " << name << "." << std::endl;
         pugi::xpath_query to_remove(("/gr:grammar/gr:derivations//" + name).c_str());
-        for (auto& element : to_remove.evaluate_node_set(grammar_)) {
+        for (auto& element : Stats::xpath(to_remove).evaluate_node_set(grammar_)) {
             element.node().parent().remove_child(element.node());
         }
     }
@@ -299,7 +328,7 @@ void grammar::model::clean_up_remove_empty_derivations()
 void grammar::model::clean_up_remove_useless_ors()
 {
     pugi::xpath_query at_least_one_or("/gr:grammar/gr:derivations//*[count(or) > 0]");
-    for (auto& element : at_least_one_or.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(at_least_one_or).evaluate_node_set(grammar_)) {
         // we start with true so that we remove leading ORs in the sequence
         bool was_or = true;
         const auto& children = element.node().children();
@@ -321,16 +350,17 @@ void grammar::model::clean_up_remove_useless_ors()
 void grammar::model::clean_up_remove_non_choices()
 {
     pugi::xpath_query non_choices("/gr:grammar/gr:derivations/*[count(or)=0 and count(@*)=0]");
-    for (auto& element : non_choices.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(non_choices).evaluate_node_set(grammar_)) {
         std::string name = element.node().name();
         pugi::xpath_query where(("/gr:grammar/gr:derivations//" + name + "[count(*)=0 and count(@*)=0 and not(text())]").c_str());
-        for (auto& target : where.evaluate_node_set(grammar_)) {
+        for (auto& target : Stats::xpath(where).evaluate_node_set(grammar_)) {
             pugi::xml_node last = target.node();
             for (auto& child : element.node().children()) {
                 last.parent().insert_copy_after(child, last);
                 last = last.next_sibling();
             }
             target.node().parent().remove_child(target.node());
+            Stats::count("derivations_inlined");
         }
         element.node().parent().remove_child(element.node());
     }
@@ -338,9 +368,11 @@ void grammar::model::clean_up_remove_non_choices()
 
 void grammar::model::clean_up_merge_disjuncitons()
 {
+    int merged = 0;
     pugi::xpath_query non_choices("/gr:grammar/gr:derivations/*[count(or)>=0 and count(@*)=0]");
-    for (auto& element : non_choices.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(non_choices).evaluate_node_set(grammar_)) {
         std::string name = element.node().name();
+        bool has_or = element.node().child("or");
         // we check that the rule is not recursive
         bool recursive = false;
         for (auto& child : element.node().children()) {
@@ -355,17 +387,29 @@ void grammar::model::clean_up_merge_disjuncitons()
         pugi::xpath_query where(("/gr:grammar/gr:derivations//" + name + "[count(*)=0 and count(@*)=0 and not(text())]").c_str());
         bool substitution_done = false;
         bool do_not_delete = false;
-        for (auto& target : where.evaluate_node_set(grammar_)) {
+        for (auto& target : Stats::xpath(where).evaluate_node_set(grammar_)) {
             // we check that the left and right siblings of target are <or/>
             auto left = target.node().previous_sibling();
             auto right = target.node().next_sibling();
             if (!(left.type() == pugi::node_null || !strcmp(left.name(), "or")) ||
                 !(right.type() == pugi::node_null || !strcmp(right.name(), "or"))) {
-                // if it was not deleted at least in one position, do not delete the rule
-                do_not_delete = true;
+                // otherwise the terminals around it are factored in the
+                // alternatives of the rule
+                if (factor_disjunction(element.node(), target.node())) {
+                    substitution_done = true;
+                    ++merged;
+                    Stats::count("derivations_inlined");
+                } else {
+                    // if it was not deleted at least in one position, do not delete the rule
+                    do_not_delete = true;
+                }
                 continue;
             }
             std::cerr << "replacing " << name << " in " << left.name() << "+" << target.node().name() << "+" << right.name() << std::endl;
+            // a parameter is saved only when a choice is merged in a choice
+            if (has_or && target.node().parent().child("or")) {
+                ++merged;
+            }
             pugi::xml_node last = target.node();
             for (auto& child : element.node().children()) {
                 last.parent().insert_copy_after(child, last);
@@ -373,18 +417,85 @@ void grammar::model::clean_up_merge_disjuncitons()
             }
             target.node().parent().remove_child(target.node());
             substitution_done = true;
+            Stats::count("derivations_inlined");
         }
         if (substitution_done && !do_not_delete) {
             std::cerr << "deleting " << element.node().name() << " from " << element.node().parent().name() << std::endl;
             element.node().parent().remove_child(element.node());
         }
     }
+    if (merged > 0) {
+        std::cerr << "merged " << merged << " disjunctions, one parameter less for each instantiation" << std::endl;
+    }
+}
+
+bool grammar::model::factor_disjunction(const pugi::xml_node& rule, pugi::xml_node target)
+{
+    // the rule has to be a choice, and target an alternative of a choice
+    // surrounded only by terminals
+    pugi::xml_node parent = target.parent();
+    if (!rule.child("or") || !parent.child("or")) {
+        return false;
+    }
+    std::vector<pugi::xml_node> prefix;
+    for (auto left = target.previous_sibling(); left && strcmp(left.name(), "or"); left = left.previous_sibling()) {
+        if (left.type() != pugi::node_cdata) {
+            return false;
+        }
+        prefix.insert(prefix.begin(), left);
+    }
+    std::vector<pugi::xml_node> suffix;
+    for (auto right = target.next_sibling(); right && strcmp(right.name(), "or"); right = right.next_sibling()) {
+        if (right.type() != pugi::node_cdata) {
+            return false;
+        }
+        suffix.push_back(right);
+    }
+
+    std::cerr << "factoring " << rule.name() << " in " << parent.name() << " with " << prefix.size() << " terminals before and ";
+    std::cerr << suffix.size() << " after" << std::endl;
+    pugi::xml_node anchor = prefix.empty() ? target : prefix.front();
+    bool first = true;
+    std::vector<pugi::xml_node> alternative;
+    auto insert_alternative = [&]() {
+        if (!first) {
+            parent.insert_child_before("or", anchor);
+        }
+        for (auto& node : prefix) {
+            parent.insert_copy_before(node, anchor);
+        }
+        for (auto& node : alternative) {
+            parent.insert_copy_before(node, anchor);
+        }
+        for (auto& node : suffix) {
+            parent.insert_copy_before(node, anchor);
+        }
+        first = false;
+        alternative.clear();
+    };
+    for (auto& child : rule.children()) {
+        if (!strcmp(child.name(), "or")) {
+            insert_alternative();
+        } else {
+            alternative.push_back(child);
+        }
+    }
+    insert_alternative();
+
+    for (auto& node : prefix) {
+        parent.remove_child(node);
+    }
+    for (auto& node : suffix) {
+        parent.remove_child(node);
+    }
+    parent.remove_child(target);
+    return true;
 }
 
 void grammar::model::clean_up_merge_cdatas()
 {
     pugi::xpath_query adjacent_cdatas("/gr:grammar/gr:derivations//*[count(text()) > 1]");
-    for (auto& element : adjacent_cdatas.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(adjacent_cdatas).evaluate_node_set(grammar_)) {
         pugi::xml_node replacement = element.node().parent().insert_child_after(element.node().name(), element.node());
         for (auto attribute : element.node().attributes()) {
             replacement.append_attribute(attribute.name());
@@ -413,8 +524,8 @@ void grammar::model::clean_up_merge_cdatas()
 void grammar::model::clean_up_remove_duplicates()
 {
     pugi::xpath_query all_elements("/gr:grammar/gr:derivations/*");
-    for (auto& rule1 : all_elements.evaluate_node_set(grammar_)) {
-        for (auto& rule2 : all_elements.evaluate_node_set(grammar_)) {
+    for (auto& rule1 : Stats::xpath(all_elements).evaluate_node_set(grammar_)) {
+        for (auto& rule2 : Stats::xpath(all_elements).evaluate_node_set(grammar_)) {
             if (rule1 != rule2 && !strcmp(rule1.node().name(), rule2.node().name())) {
                 bool same = true;
                 for (auto& attribute : rule1.node().attributes()) {
@@ -435,10 +546,10 @@ void grammar::model::clean_up_remove_duplicates()
 void grammar::model::clean_up_remove_non_used_rules()
 {
     pugi::xpath_query all_elements("/gr:grammar/gr:derivations/*[not(@output) and not(@destination) and not(@destination_dir)]");
-    for (auto& element : all_elements.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(all_elements).evaluate_node_set(grammar_)) {
         std::string name = element.node().name();
         pugi::xpath_query where(("/gr:grammar/gr:derivations//" + name + "[count(*)=0 and count(@*)=0 and not(text())]").c_str());
-        if (where.evaluate_node_set(grammar_).size() == 0) {
+        if (Stats::xpath(where).evaluate_node_set(grammar_).size() == 0) {
             std::cout << "Removing unused rule " << element.node().name() << "." << std::endl;
             element.node().parent().remove_child(element.node());
         }
@@ -451,8 +562,8 @@ void grammar::model::warn_for_duplicate_derivations()
     // children have the same name
     bool warnings = false;
     pugi::xpath_query all_elements("/gr:grammar/gr:derivations/*");
-    for (auto& element1 : all_elements.evaluate_node_set(grammar_)) {
-        for (auto& element2 : all_elements.evaluate_node_set(grammar_)) {
+    for (auto& element1 : Stats::xpath(all_elements).evaluate_node_set(grammar_)) {
+        for (auto& element2 : Stats::xpath(all_elements).evaluate_node_set(grammar_)) {
             if (has_children(element1.node()) && has_children(element2.node()) && strcmp(element1.node().name(), element2.node().name())) {
                 std::vector<std::string> children1;
                 std::vector<std::string> children2;
@@ -510,10 +621,10 @@ void grammar::model::rename_calls_inside_block(std::vector<pugi::xml_node>& bloc
             element.set_name(new_name.c_str());
             // check if there is already a derivation with this name
             pugi::xpath_query all_elements(("/gr:grammar/gr:derivations/" + new_name).c_str());
-            if (all_elements.evaluate_node_set(grammar_).empty()) {
+            if (Stats::xpath(all_elements).evaluate_node_set(grammar_).empty()) {
                 std::string to_duplicate = (curr_val == 1) ? name : name + std::to_string(curr_val);
                 pugi::xpath_query target_query(("/gr:grammar/gr:derivations/" + to_duplicate).c_str());
-                auto target = target_query.evaluate_node_set(grammar_).first();
+                auto target = Stats::xpath(target_query).evaluate_node_set(grammar_).first();
                 target.node().parent().insert_copy_after(target.node(), target.node());
                 target.node().next_sibling(to_duplicate.c_str()).set_name(new_name.c_str());
             }
@@ -524,7 +635,7 @@ void grammar::model::rename_calls_inside_block(std::vector<pugi::xml_node>& bloc
 void grammar::model::rename_calls()
 {
     pugi::xpath_query derivation("/gr:grammar/gr:derivations/*[count(*)>=0]");
-    for (auto& element : derivation.evaluate_node_set(grammar_)) {
+    for (auto& element : Stats::xpath(derivation).evaluate_node_set(grammar_)) {
         // for all children we make subset of elements separated by ORs
         std::vector<pugi::xml_node> block;
         block.clear();
@@ -554,142 +665,165 @@ struct xml_string_writer: pugi::xml_writer
     }
 };
 
+static std::string xml_sequence(const std::vector<pugi::xml_node>& nodes)
+{
+    xml_string_writer writer;
+    for (auto& node : nodes) {
+        node.print(writer, "\t", pugi::format_raw | pugi::format_no_declaration);
+    }
+    return writer.result;
+}
+
 void grammar::model::clean_up_simplify_recursions()
 {
     pugi::xpath_query all_elements("/gr:grammar/gr:derivations/*[not(@output) and not(@destination) and not(@destination_dir)]");
-    for (auto& element : all_elements.evaluate_node_set(grammar_)) {
-        std::string name = element.node().name();
-        bool recursive = false;
+    for (auto& element : Stats::xpath(all_elements).evaluate_node_set(grammar_)) {
+        std::string rec_node = element.node().name();
+        // checking the number of ORs
+        int num_ors = 0;
         for (auto& child : element.node().children()) {
-            if (child.type() == pugi::node_element && !strcmp(element.node().name(), child.name())) {
-                recursive = true;
+            if (!strcmp(child.name(), "or")) {
+                num_ors++;
             }
         }
-        // rule is recursive check if one of the following four cases:
-        // A ::= B | BA
-        // A ::= B | AB
-        // A ::= BA | B
-        // A ::= AB | B
-        if (recursive) {
-            // checking the number of ORs
-            int num_ors = 0;
-            for (auto& child : element.node().children()) {
-                if (!strcmp(child.name(), "or")) {
-                    num_ors++;
-                }
-            }
-            if (num_ors != 1) {
-                break;
-            }
-            // collecting elements before and after the OR
-            std::vector<pugi::xml_node> left;
-            std::vector<pugi::xml_node> right;
-            std::vector<pugi::xml_node> *current = &left;
-            for (auto& child : element.node().children()) {
-                if (!strcmp(child.name(), "or")) {
-                    current = &right;
-                } else {
-                    current->push_back(child);
-                }
-            }
-            // check they have the right number of elements
-            std::vector<pugi::xml_node> *stop;
-            std::vector<pugi::xml_node> *cont;
-            if (left.size() == 1 && right.size() == 2) {
-                stop = &left;
-                cont = &right;
-            } else if (left.size() == 1 && right.size() == 1) {
-                stop = &right;
-                cont = &left;
+        if (num_ors != 1) {
+            continue;
+        }
+        // collecting elements before and after the OR
+        std::vector<pugi::xml_node> left;
+        std::vector<pugi::xml_node> right;
+        std::vector<pugi::xml_node> *current = &left;
+        for (auto& child : element.node().children()) {
+            if (!strcmp(child.name(), "or")) {
+                current = &right;
             } else {
-                break;
+                current->push_back(child);
             }
-            // find name of the recursive rule
-            std::string rec_node = element.node().name();
-            // find name of the other rule or content (in case of CDATA)
-            std::string oth_node;
-            if ((*stop)[0].type() == pugi::node_element) {
-                oth_node = (*stop)[0].name();
-                // element with children
-                if (has_children((*stop)[0])) {
-                    break;
+        }
+        // the rule is recursive if exactly one of the two alternatives calls
+        // the rule once; the other one is the stop alternative
+        auto recursive_calls = [&rec_node](const std::vector<pugi::xml_node>& alternative) {
+            int calls = 0;
+            for (auto& node : alternative) {
+                if (node.type() == pugi::node_element && rec_node == node.name()) {
+                    ++calls;
                 }
-                // element has the same name of the recursive rule
-                if (rec_node == oth_node) {
-                    break;
+            }
+            return calls;
+        };
+        std::vector<pugi::xml_node> *stop;
+        std::vector<pugi::xml_node> *cont;
+        if (recursive_calls(left) == 0 && recursive_calls(right) == 1) {
+            stop = &left;
+            cont = &right;
+        } else if (recursive_calls(left) == 1 && recursive_calls(right) == 0) {
+            stop = &right;
+            cont = &left;
+        } else {
+            continue;
+        }
+        // the nodes have to be terminals or calls, and the stop alternative
+        // has to be something else than the empty one left by a previous
+        // simplification
+        bool simple = true;
+        for (auto* alternative : {stop, cont}) {
+            for (auto& node : *alternative) {
+                if (has_children(node) || (node.type() != pugi::node_element && node.type() != pugi::node_cdata)) {
+                    simple = false;
                 }
-            } else if ((*stop)[0].type() == pugi::node_cdata) {
-                std::string oth_node = (*stop)[0].value();
-            } else {
-                break;
             }
-            // selecting which of the two in cont is the one to non recursive
-            pugi::xml_node *to_check;
-            if ((*cont)[0].name() == rec_node) {
-                to_check = &((*cont)[1]);
-            } else if ((*cont)[1].name() == rec_node) {
-                to_check = &((*cont)[0]);
-            } else {
-                break;
+        }
+        // the stop alternative is copied where the rule is used, ranges are
+        // not moved since their parameter name depends on where they are
+        for (auto& node : *stop) {
+            if (node.first_attribute()) {
+                simple = false;
             }
-            // checking if rule is one of the four cases (in the check above
-            // we already verified that one of the cont is the recursive one
-            // now we have to see if the other in cont corresponds to stop
-            if (to_check->type() != (*stop)[0].type()) {
-                break;
+        }
+        if (!simple || stop->empty()) {
+            continue;
+        }
+        if (stop->size() == 1 && (*stop)[0].type() == pugi::node_cdata) {
+            std::string value = (*stop)[0].value();
+            if (value.find_first_not_of(" \t\r\n") == std::string::npos) {
+                continue;
             }
-            if (to_check->type() == pugi::node_element) {
-                if (has_children(*to_check)) {
-                    break;
-                }
-                if (strcmp(to_check->name(), (*stop)[0].name())) {
-                    break;
-                }
+        }
+        // splitting the recursive alternative in prefix and suffix of the
+        // recursive call: A ::= S | P A Q
+        std::vector<pugi::xml_node> prefix;
+        std::vector<pugi::xml_node> suffix;
+        pugi::xml_node rec_call;
+        for (auto& node : *cont) {
+            if (node.type() == pugi::node_element && rec_node == node.name()) {
+                rec_call = node;
+            } else if (rec_call) {
+                suffix.push_back(node);
             } else {
-                if (strcmp(to_check->value(), (*stop)[0].value())) {
-                    break;
-                }
+                prefix.push_back(node);
             }
+        }
+        // with both a prefix and a suffix the derivations P^k S Q^k cannot be
+        // written as a repetition followed or preceded by the stop alternative
+        if (!prefix.empty() && !suffix.empty()) {
+            continue;
+        }
 
-            // the rule is actually recursive now we have to replace wherever
-            // it is used with oth_node and rec_node and replace the single
-            // occourrence of oth_node with an empty CDATA
-            
-            // replacing where needed rec_node with rec_node oth_node (the order
-            // here is not important)
-            pugi::xpath_query where(("/gr:grammar/gr:derivations//" + rec_node + "[count(*)=0 and count(@*)=0 and not(text())]").c_str());
-            for (auto& used_elem : where.evaluate_node_set(grammar_)) {
-                if (used_elem.node() == (*cont)[1]) {
-                    continue;
-                }
-                pugi::xml_node temp = used_elem.node().parent().insert_child_before((*stop)[0].type(), used_elem.node());
-                if (temp.type() == pugi::node_cdata) {
-                    temp.set_value((*stop)[0].value());
-                } else if (temp.type() == pugi::node_element) {
-                    temp.set_name((*stop)[0].name());
+        // the rule becomes A ::= [] | X A where X is the repeated part:
+        // A ::= S | P A is P^k S, and where A is used it becomes A S (or S A
+        // when P == S, since then the two are the same)
+        // A ::= S | A Q is S Q^k, and where A is used it becomes S A
+        std::string stop_xml = xml_sequence(*stop);
+        bool stop_before = !suffix.empty() || xml_sequence(prefix) == stop_xml;
+
+        // replacing where needed rec_node with the stop alternative and
+        // rec_node, skipping the recursive call in the rule itself
+        pugi::xpath_query where(("/gr:grammar/gr:derivations//" + rec_node + "[count(*)=0 and count(@*)=0 and not(text())]").c_str());
+        for (auto& used_elem : Stats::xpath(where).evaluate_node_set(grammar_)) {
+            if (used_elem.node().parent() == element.node()) {
+                continue;
+            }
+            pugi::xml_node used = used_elem.node();
+            pugi::xml_node last = used;
+            for (auto& node : *stop) {
+                if (stop_before) {
+                    used.parent().insert_copy_before(node, used);
+                } else {
+                    last = used.parent().insert_copy_after(node, last);
                 }
             }
-            
-            // saving old rule for printing a note
-            xml_string_writer writer1;
-            element.node().print(writer1, "\t", pugi::format_raw | pugi::format_no_declaration);
-            std::string old_rule = writer1.result;
-            
-            // changing current oth_node with cdata
-            pugi::xml_node empty = (*stop)[0].parent().insert_child_after(pugi::node_cdata, (*stop)[0]);
-            empty.set_value(" ");
-            (*stop)[0].parent().remove_child((*stop)[0]);
-            
-            // saving new rule for printing a note
-            xml_string_writer writer2;
-            element.node().print(writer2, "\t", pugi::format_raw | pugi::format_no_declaration);
-            std::string new_rule = writer2.result;
-            
-            // printing a note as a warning that such transformation took place
-            std::cout << "To reduce the number of parameters to generate, the recursive rule:\n" << old_rule << std::endl;
-            std::cout << "has been simplified to:\n" + new_rule << "." << std::endl;
-            std::cout << "All occurrences of <" << rec_node << "/> in the grammar ";
-            std::cout << "have also been replaced by <" << oth_node << "/><" << rec_node << "/>." << std::endl;
+        }
+
+        // saving old rule for printing a note
+        xml_string_writer writer1;
+        element.node().print(writer1, "\t", pugi::format_raw | pugi::format_no_declaration);
+        std::string old_rule = writer1.result;
+
+        // changing the stop alternative with an empty cdata, and moving the
+        // suffix of a left recursion before the recursive call
+        pugi::xml_node empty = element.node().insert_child_before(pugi::node_cdata, (*stop)[0]);
+        empty.set_value(" ");
+        for (auto& node : *stop) {
+            element.node().remove_child(node);
+        }
+        for (auto& node : suffix) {
+            element.node().insert_copy_before(node, rec_call);
+            element.node().remove_child(node);
+        }
+
+        // saving new rule for printing a note
+        xml_string_writer writer2;
+        element.node().print(writer2, "\t", pugi::format_raw | pugi::format_no_declaration);
+        std::string new_rule = writer2.result;
+
+        // printing a note as a warning that such transformation took place
+        std::cout << "To reduce the number of parameters to generate, the recursive rule:\n" << old_rule << std::endl;
+        std::cout << "has been simplified to:\n" + new_rule << "." << std::endl;
+        std::cout << "All occurrences of <" << rec_node << "/> in the grammar ";
+        if (stop_before) {
+            std::cout << "have also been replaced by " << stop_xml << "<" << rec_node << "/>." << std::endl;
+        } else {
+            std::cout << "have also been replaced by <" << rec_node << "/>" << stop_xml << "." << std::endl;
         }
     }
 }
@@ -0,0 +1,315 @@
+//
+//  parameter_space.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "basic_configuration.hpp"
+#include "error.hpp"
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/split.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define SPACE_MAGIC "G2CS"
+#define SPACE_VERSION 2
+
+static std::string json_string(const std::string& text)
+{
+    std::ostringstream escaped;
+    escaped << "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped << '\\' << c;
+        } else if (c < 0x20) {
+            escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+        } else {
+            escaped << c;
+        }
+    }
+    escaped << "\"";
+    return escaped.str();
+}
+
+// all the numbers are written in little endian
+template <typename T>
+static void write_le(std::ostream& stream, T value)
+{
+    uint64_t bits = 0;
+    static_assert(sizeof(T) <= sizeof(bits), "value too large");
+    std::memcpy(&bits, &value, sizeof(T));
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        stream.put(static_cast<char>((bits >> (8 * i)) & 0xff));
+    }
+}
+
+static void write_string(std::ostream& stream, const std::string& text)
+{
+    write_le<uint32_t>(stream, static_cast<uint32_t>(text.size()));
+    stream.write(text.data(), text.size());
+}
+
+grammar::parameter_space::parameter_space(std::shared_ptr<grammar::model>& a_model, int max_depth, bool keep_degenerate, bool recursion_count) : basic_configuration(a_model, max_depth)
+{
+    // the walk of configuration fills the table through fmt_parameter
+    set_keep_degenerate(keep_degenerate);
+    set_recursion_count(recursion_count);
+    generate();
+    for (auto& folded : folded_) {
+        folded_names_.insert(rule_name(folded.first).second);
+    }
+
+    for (size_t i = 0; i < table_.size(); ++i) {
+        auto parent = index_.find(pending_parents_[i]);
+        if (parent != index_.end()) {
+            table_[i].parent = parent->second;
+        }
+    }
+    pending_parents_.clear();
+}
+
+std::string grammar::parameter_space::fmt_rule_name(const std::string& path)
+{
+    return rule_name(path).second;
+}
+
+std::string grammar::parameter_space::fmt_rule_cond(const std::string& path, const std::string& node_name, int rec_index)
+{
+    auto cond = rule_cond(path, node_name, rec_index);
+    if (cond.first.empty() || cond.second.empty()) {
+        return "";
+    }
+    return rule_name(cond.first).second + "=" + cond.second;
+}
+
+void grammar::parameter_space::fmt_parameter(const std::string& rule_name, const std::string& rule_type, const std::vector<std::string>& values, std::string default_value, bool log_scale, std::string rule_cond)
+{
+    parameter param;
+    param.name = rule_name;
+    param.type = rule_type;
+    param.values = values;
+    param.default_value = default_value;
+    if (param.default_value.empty() && !values.empty()) {
+        param.default_value = values.front();
+    }
+    param.log_scale = log_scale;
+    param.parent = -1;
+
+    std::string parent;
+    size_t equal = rule_cond.rfind('=');
+    if (equal != std::string::npos) {
+        parent = rule_cond.substr(0, equal);
+        // the condition on a recursion count lists all the counts
+        // that reach the level
+        std::string parent_values = rule_cond.substr(equal + 1);
+        boost::split(param.parent_values, parent_values, boost::is_any_of(", "), boost::token_compress_on);
+    }
+    pending_parents_.push_back(parent);
+    index_[rule_name] = static_cast<int>(table_.size());
+    table_.push_back(param);
+}
+
+void grammar::parameter_space::merge(parameter_space& worker)
+{
+    basic_configuration::merge(worker);
+    for (auto& param : worker.table_) {
+        index_[param.name] = static_cast<int>(table_.size());
+        table_.push_back(param);
+    }
+    pending_parents_.insert(pending_parents_.end(), worker.pending_parents_.begin(), worker.pending_parents_.end());
+}
+
+const std::vector<grammar::parameter_space::parameter>& grammar::parameter_space::parameters() const
+{
+    return table_;
+}
+
+bool grammar::parameter_space::in_domain(const parameter& param, const std::string& value) const
+{
+    if (param.type == "categorical" || param.type == "ordinal") {
+        return std::find(param.values.begin(), param.values.end(), value) != param.values.end();
+    }
+    try {
+        size_t parsed = 0;
+        if (param.type == "int") {
+            long number = std::stol(value, &parsed);
+            return parsed == value.size() && number >= std::stol(param.values[0]) && number <= std::stol(param.values[1]);
+        }
+        double number = std::stod(value, &parsed);
+        return parsed == value.size() && number >= std::stod(param.values[0]) && number <= std::stod(param.values[1]);
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+grammar::parameter_space::report grammar::parameter_space::validate(std::unordered_map<std::string, std::string>& configuration, bool complete) const
+{
+    report result;
+    std::vector<bool> active(table_.size());
+    for (size_t i = 0; i < table_.size(); ++i) {
+        const parameter& param = table_[i];
+        active[i] = true;
+        if (param.parent >= 0) {
+            auto parent = configuration.find(table_[param.parent].name);
+            active[i] = active[param.parent] && parent != configuration.end() &&
+                        std::find(param.parent_values.begin(), param.parent_values.end(), parent->second) != param.parent_values.end();
+        }
+        auto value = configuration.find(param.name);
+        if (active[i]) {
+            if (value == configuration.end()) {
+                result.missing.push_back(param.name);
+                if (complete) {
+                    configuration[param.name] = param.default_value;
+                }
+            } else if (!in_domain(param, value->second)) {
+                result.out_of_range.push_back(param.name + "=" + value->second);
+            }
+        } else if (value != configuration.end()) {
+            result.inactive.push_back(param.name);
+            if (complete) {
+                configuration.erase(value);
+            }
+        }
+    }
+    for (auto it = configuration.begin(); it != configuration.end(); ) {
+        if (index_.find(it->first) == index_.end()) {
+            if (folded_names_.find(it->first) == folded_names_.end()) {
+                result.unknown.push_back(it->first);
+            }
+            if (complete) {
+                it = configuration.erase(it);
+                continue;
+            }
+        }
+        ++it;
+    }
+    std::sort(result.unknown.begin(), result.unknown.end());
+    return result;
+}
+
+bool grammar::parameter_space::report::valid() const
+{
+    return missing.empty() && out_of_range.empty() && inactive.empty() && unknown.empty();
+}
+
+void grammar::parameter_space::report::print(std::ostream& stream) const
+{
+    for (auto& name : missing) {
+        stream << "missing parameter " << name << std::endl;
+    }
+    for (auto& name : out_of_range) {
+        stream << "out of range parameter " << name << std::endl;
+    }
+    for (auto& name : inactive) {
+        stream << "inactive parameter " << name << std::endl;
+    }
+    for (auto& name : unknown) {
+        stream << "unknown parameter " << name << std::endl;
+    }
+}
+
+void grammar::parameter_space::print(std::ostream& stream)
+{
+    for (auto& param : table_) {
+        stream << param.name << " " << param.type << " (" << boost::join(param.values, ", ") << ") " << param.default_value;
+        if (param.log_scale) {
+            stream << " log";
+        }
+        if (param.parent >= 0) {
+            stream << " | " << table_[param.parent].name << " in (" << boost::join(param.parent_values, ", ") << ")";
+        }
+        stream << std::endl;
+    }
+}
+
+int grammar::parameter_space::value_index(const parameter& param, const std::string& value) const
+{
+    auto it = std::find(param.values.begin(), param.values.end(), value);
+    return it == param.values.end() ? -1 : static_cast<int>(it - param.values.begin());
+}
+
+void grammar::parameter_space::write_json(std::ostream& stream) const
+{
+    stream << "{" << std::endl;
+    stream << "  \"format\": \"grammar2code-space\"," << std::endl;
+    stream << "  \"version\": " << SPACE_VERSION << "," << std::endl;
+    stream << "  \"max_depth\": " << max_depth_ << "," << std::endl;
+    stream << "  \"parameters\": [" << std::endl;
+    stream << std::setprecision(std::numeric_limits<double>::max_digits10);
+    for (size_t i = 0; i < table_.size(); ++i) {
+        const parameter& param = table_[i];
+        stream << "    {\"name\": " << json_string(param.name) << ", \"type\": \"" << param.type << "\", ";
+        if (param.type == "categorical" || param.type == "ordinal") {
+            stream << "\"values\": [";
+            for (size_t j = 0; j < param.values.size(); ++j) {
+                stream << (j ? ", " : "") << json_string(param.values[j]);
+            }
+            stream << "], \"default\": " << json_string(param.default_value) << ", ";
+        } else if (param.type == "int") {
+            stream << "\"min\": " << std::stol(param.values[0]) << ", \"max\": " << std::stol(param.values[1]);
+            stream << ", \"default\": " << std::stol(param.default_value) << ", ";
+        } else {
+            stream << "\"min\": " << std::stod(param.values[0]) << ", \"max\": " << std::stod(param.values[1]);
+            stream << ", \"default\": " << std::stod(param.default_value) << ", ";
+        }
+        stream << "\"log_scale\": " << (param.log_scale ? "true" : "false") << ", ";
+        stream << "\"parent\": " << param.parent << ", \"parent_values\": [";
+        for (size_t j = 0; j < param.parent_values.size(); ++j) {
+            stream << (j ? ", " : "") << json_string(param.parent_values[j]);
+        }
+        stream << "]}" << (i + 1 < table_.size() ? "," : "") << std::endl;
+    }
+    stream << "  ]" << std::endl << "}" << std::endl;
+}
+
+void grammar::parameter_space::write_binary(std::ostream& stream) const
+{
+    stream.write(SPACE_MAGIC, 4);
+    write_le<uint32_t>(stream, SPACE_VERSION);
+    write_le<int32_t>(stream, max_depth_);
+    write_le<uint32_t>(stream, static_cast<uint32_t>(table_.size()));
+    for (auto& param : table_) {
+        write_string(stream, param.name);
+        uint8_t type = param.type == "categorical" ? 0 : (param.type == "int" ? 1 : (param.type == "real" ? 2 : 3));
+        write_le<uint8_t>(stream, type);
+        write_le<uint8_t>(stream, param.log_scale ? 1 : 0);
+        write_le<int32_t>(stream, param.parent);
+        if (type == 0 || type == 3) {
+            write_le<uint32_t>(stream, static_cast<uint32_t>(param.values.size()));
+            for (auto& value : param.values) {
+                write_string(stream, value);
+            }
+            write_le<int32_t>(stream, value_index(param, param.default_value));
+        } else if (type == 1) {
+            write_le<int64_t>(stream, std::stoll(param.values[0]));
+            write_le<int64_t>(stream, std::stoll(param.values[1]));
+            write_le<int64_t>(stream, std::stoll(param.default_value));
+        } else {
+            write_le<double>(stream, std::stod(param.values[0]));
+            write_le<double>(stream, std::stod(param.values[1]));
+            write_le<double>(stream, std::stod(param.default_value));
+        }
+        // the values of the parent are the indices of its choices
+        write_le<uint32_t>(stream, static_cast<uint32_t>(param.parent >= 0 ? param.parent_values.size() : 0));
+        if (param.parent >= 0) {
+            for (auto& value : param.parent_values) {
+                write_le<int32_t>(stream, value_index(table_[param.parent], value));
+            }
+        }
+    }
+}
+
+template class grammar::basic_walker<grammar::parameter_space>;
+template class grammar::basic_configuration<grammar::parameter_space>;
@@ -10,6 +10,7 @@
 //
 
 #include "grammar.hpp"
+#include "basic_configuration.hpp"
 #include "error.hpp"
 
 #include <boost/algorithm/string/join.hpp>
@@ -46,12 +47,15 @@ void grammar::paramils_conf::fmt_parameter(const std::string& rule_name, const s
     conditionals_.push_back(rule_cond);
 }
 
-void grammar::paramils_conf::callback_range(const pugi::xml_node& node, std::string path, int depth)
+void grammar::paramils_conf::callback_range(const pugi::xml_node& node, const std::string& path, int depth)
 {
+    std::string type = node.attribute("type").value();
+    if ((type == "int" || type == "real") && fixed_range(node) && fold_degenerate(path, node.name())) {
+        return;
+    }
     std::string rule = fmt_rule_name(path);
     std::string cond = fmt_rule_cond(path, node.name());
     std::vector<std::string> choices;
-    std::string type = node.attribute("type").value();
     // default value
     std::string default_value;
     if (strcmp(node.attribute("default").value(), "")) {
@@ -83,11 +87,21 @@ void grammar::paramils_conf::callback_range(const pugi::xml_node& node, std::str
     }
 }
 
-void grammar::paramils_conf::print(std::ostream& stream)
+void grammar::paramils_conf::merge(paramils_conf& worker)
+{
+    basic_configuration::merge(worker);
+    conditionals_.insert(conditionals_.end(), worker.conditionals_.begin(), worker.conditionals_.end());
+}
+
+void grammar::paramils_conf::reset()
 {
+    basic_configuration::reset();
     conditionals_.clear();
-    
-    grammar::configuration::print(stream);
+}
+
+void grammar::paramils_conf::write(std::ostream& stream)
+{
+    basic_configuration::write(stream);
 
     stream << "\nConditionals:" << std::endl;
     for (auto& conditional : conditionals_) {
@@ -96,3 +110,6 @@ void grammar::paramils_conf::print(std::ostream& stream)
         }
     }
 }
+
+template class grammar::basic_walker<grammar::paramils_conf>;
+template class grammar::basic_configuration<grammar::paramils_conf>;
@@ -11,8 +11,12 @@
 
 #include "grammar.hpp"
 #include "error.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "workers.hpp"
 
 #include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/erase.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/split.hpp>
@@ -21,16 +25,109 @@
 #include <boost/filesystem.hpp>
 #include <boost/version.hpp>
 
+#include <algorithm>
+#include <sstream>
+
 #if (BOOST_VERSION / 100000) < 1 || ((BOOST_VERSION / 100) % 1000) < 48
 #define normalise_path(path_s)(boost::filesystem::absolute(path_s))
 #else
 #define normalise_path(path_s)(boost::filesystem::canonical(path_s))
 #endif
 
+// parameter names are the paths of the walker with ':' replaced by '-', and
+// the path of each node starts with the name of its output root
+static bool under_root(const std::string& name, const std::string& prefix)
+{
+    if (!boost::starts_with(name, prefix)) {
+        return false;
+    }
+    return name.size() == prefix.size() || name[prefix.size()] == '%' || name[prefix.size()] == '@';
+}
+
+bool grammar::params2code::is_c_family(const boost::filesystem::path& file)
+{
+    static const std::vector<std::string> extensions = {
+        ".c", ".cc", ".cpp", ".cxx", ".C", ".h", ".hh", ".hpp", ".hxx", ".H"
+    };
+    return std::find(extensions.begin(), extensions.end(), file.extension().string()) != extensions.end();
+}
+
+// path of target relative to the directory base, both made absolute first
+static boost::filesystem::path relative_path(const boost::filesystem::path& target, const boost::filesystem::path& base)
+{
+    std::vector<boost::filesystem::path> target_parts;
+    std::vector<boost::filesystem::path> base_parts;
+    for (auto& part : boost::filesystem::absolute(target)) {
+        if (part != ".") {
+            target_parts.push_back(part);
+        }
+    }
+    for (auto& part : boost::filesystem::absolute(base)) {
+        if (part != ".") {
+            base_parts.push_back(part);
+        }
+    }
+    size_t common = 0;
+    while (common < target_parts.size() && common < base_parts.size() && target_parts[common] == base_parts[common]) {
+        ++common;
+    }
+    boost::filesystem::path relative;
+    for (size_t i = common; i < base_parts.size(); ++i) {
+        relative /= "..";
+    }
+    for (size_t i = common; i < target_parts.size(); ++i) {
+        relative /= target_parts[i];
+    }
+    return relative;
+}
+
+// length of the longest prefix of the invariant code that can be moved to a
+// header, i.e., that ends with a complete line outside of comments and of
+// preprocessor conditionals (that cannot span several files)
+static size_t safe_split(const std::string& code)
+{
+    size_t split = 0;
+    int conditionals = 0;
+    bool comment = false;
+    size_t begin = 0;
+    while (begin < code.size()) {
+        size_t end = code.find('\n', begin);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string line = boost::trim_copy(code.substr(begin, end - begin));
+        if (!comment && boost::starts_with(line, "#")) {
+            std::string directive = boost::trim_copy(line.substr(1));
+            if (boost::starts_with(directive, "if")) {
+                ++conditionals;
+            } else if (boost::starts_with(directive, "endif")) {
+                --conditionals;
+            }
+        }
+        for (size_t pos = 0; pos + 1 < line.size(); ++pos) {
+            if (!comment && line.compare(pos, 2, "/*") == 0) {
+                comment = true;
+                ++pos;
+            } else if (comment && line.compare(pos, 2, "*/") == 0) {
+                comment = false;
+                ++pos;
+            } else if (!comment && line.compare(pos, 2, "//") == 0) {
+                break;
+            }
+        }
+        begin = end + 1;
+        if (conditionals == 0 && !comment) {
+            split = begin;
+        }
+    }
+    return split;
+}
+
 // passing std::numeric_limits<int>::max() as max_depth to the constructor of
 // walker since when generating the code the depth is actually limited by the
-// parameters
-grammar::params2code::params2code(std::shared_ptr<grammar::model>& a_model, std::unordered_map<std::string, std::string>& parameters, boost::filesystem::path target_dir, std::ostream& stream, bool do_not_reindent) : walker(a_model, std::numeric_limits<int>::max()), parameters_{parameters}, target_dir_{target_dir}, stream_(stream), do_not_reindent_(do_not_reindent), code_(), current_fout_(new std::ofstream())
+// parameters; with set_max_depth the walk stops at the --depth of the
+// configurations, and a parameter that recurses further is rejected
+grammar::params2code::params2code(std::shared_ptr<grammar::model>& a_model, std::unordered_map<std::string, std::string>& parameters, boost::filesystem::path target_dir, std::ostream& stream, bool do_not_reindent) : walker(a_model, std::numeric_limits<int>::max()), target_dir_{target_dir}, stream_(stream), code_(), do_not_reindent_(do_not_reindent), parameters_{parameters}, deferred_output_(false), current_fout_(new std::ofstream())
 {
 }
 
@@ -81,13 +178,57 @@ int grammar::params2code::callback_recursive(const pugi::xml_node& node, std::st
             break;
         }
     }
+    if (choice == -1) {
+        choice = recursion_count_choice(node, path, depth);
+    }
+    int levels = remaining_levels(node, recursion_level(path, depth), depth);
+    if (choice == -1 && levels <= 1) {
+        // the last level has only the base alternative left, and it is folded
+        // in the configurations
+        choice = base_alternative(node);
+    }
     if (choice == -1) {
         Error::fatal("No parameter to translate '" + path + "'.");
     }
-    
+
+    // the walker silently skips a recursion deeper than the --depth or the
+    // max-depth of the rule, which would produce incomplete code
+    if (levels <= 1) {
+        auto choices = get_choice(node.children());
+        if (choice >= 0 && choice < (int) choices.size()) {
+            for (auto& child : choices[choice]) {
+                if (!strcmp(child.name(), node.name())) {
+                    Error::fatal("Parameter '" + path + "' recurses deeper than the maximum depth of " + node.name() + ".");
+                }
+            }
+        }
+    }
+
     return choice;
 }
 
+int grammar::params2code::recursion_count_choice(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    int recursive = list_recursion(node);
+    if (recursive == -1) {
+        return -1;
+    }
+    std::string parent = path;
+    boost::erase_last(parent, "@" + std::to_string(depth));
+    auto count = recursion_counts_.find(parent);
+    if (count == recursion_counts_.end() || depth <= count->second.first) {
+        // first level of the recursion, the count replaces all the levels
+        auto it = parameters_.find(parent + "@reps");
+        if (it == parameters_.end()) {
+            return -1;
+        }
+        recursion_counts_[parent] = std::make_pair(depth, std::stoi(it->second));
+        count = recursion_counts_.find(parent);
+        parameters_.erase(it);
+    }
+    return depth - count->second.first < count->second.second ? recursive : 1 - recursive;
+}
+
 void grammar::params2code::callback_range(const pugi::xml_node& node, std::string path, int depth)
 {
     bool found = false;
@@ -100,10 +241,15 @@ void grammar::params2code::callback_range(const pugi::xml_node& node, std::strin
             break;
         }
     }
-    if (!found) {
+    if (fixed_range(node)) {
+        // folded in the configurations, the value passed if any is ignored
+        if (found) {
+            code_.pop_back();
+        }
+        code_.push_back(node.attribute("min").value());
+    } else if (!found) {
         Error::fatal("No parameter to translate '" + path + "'.");
     }
-
 }
 
 void grammar::params2code::callback_copy(const pugi::xml_node& node, std::string path, int depth)
@@ -124,6 +270,10 @@ void grammar::params2code::callback_plain(const pugi::xml_node& node, std::strin
 
 void grammar::params2code::output_file(boost::filesystem::path output_file)
 {
+    if (deferred_output_) {
+        current_output_ = output_file;
+        return;
+    }
     write_and_close_current_output_file();
     
     // create target dir if not there
@@ -140,12 +290,14 @@ void grammar::params2code::output_file(boost::filesystem::path output_file)
     if (!current_fout_->good()) {
         Error::fatal("Could not write " + output_file.string() + ".");
     }
+    files_.push_back(output_file);
+    current_output_ = output_file;
 }
 
 void grammar::params2code::copy_single_files()
 {
     pugi::xpath_query to_be_copied("/gr:grammar/gr:derivations/*[@source and @destination]");
-    for (auto& element : to_be_copied.evaluate_node_set(model_->grammar())) {
+    for (auto& element : Stats::xpath(to_be_copied).evaluate_node_set(model_->grammar())) {
         boost::filesystem::path source(element.node().attribute("source").value());
         boost::filesystem::path destination(element.node().attribute("destination").value());
         
@@ -161,6 +313,8 @@ void grammar::params2code::copy_single_files()
         
         stream_ << "Copying " << src.string() << " to " << dst.string() << std::endl;
         boost::filesystem::copy_file(src, dst, boost::filesystem::copy_option::overwrite_if_exists);
+        Stats::count("files_copied");
+        files_.push_back(destination);
     }
     stream_ << std::endl;
 }
@@ -168,7 +322,7 @@ void grammar::params2code::copy_single_files()
 void grammar::params2code::copy_files_with_filter()
 {
     pugi::xpath_query to_be_copied("/gr:grammar/gr:derivations/*[@source_dir and @destination_dir and @regex_filter]");
-    for (auto& element : to_be_copied.evaluate_node_set(model_->grammar())) {
+    for (auto& element : Stats::xpath(to_be_copied).evaluate_node_set(model_->grammar())) {
         boost::filesystem::path source(element.node().attribute("source_dir").value());
         boost::filesystem::path destination(element.node().attribute("destination_dir").value());
         std::string files_filter = element.node().attribute("regex_filter").value();
@@ -196,6 +350,8 @@ void grammar::params2code::copy_files_with_filter()
                     boost::filesystem::path cp_dst = dst / filename;
                     stream_ << "Copying " << cp_src << " to " << cp_dst << std::endl;
                     boost::filesystem::copy_file(cp_src, cp_dst, boost::filesystem::copy_option::overwrite_if_exists);
+                    Stats::count("files_copied");
+                    files_.push_back(destination / filename);
                 }
             }
         }
@@ -203,11 +359,26 @@ void grammar::params2code::copy_files_with_filter()
     stream_ << std::endl;
 }
 
-void grammar::params2code::write_and_close_current_output_file()
+std::string grammar::params2code::render_code()
 {
-    if (!code_.empty()) {
-        // merging cdata blocks and then re-splitting into lines
-        std::string code = boost::join(code_, "");
+    if (code_.empty()) {
+        return "";
+    }
+    // merging cdata blocks
+    std::string code = boost::join(code_, "");
+    auto invariant = invariants_.find(current_output_.generic_string());
+    if (invariant != invariants_.end() && boost::starts_with(code, invariant->second)) {
+        std::string header = invariant_header(current_output_, invariant->second);
+        return "#include \"" + header + "\"\n" + render_code(code.substr(invariant->second.size()));
+    }
+    return render_code(code);
+}
+
+std::string grammar::params2code::render_code(const std::string& code)
+{
+    std::ostringstream rendered;
+    if (!code.empty()) {
+        // re-splitting into lines
         std::vector<std::string> lines;
         boost::split(lines, code, boost::is_any_of("\n\r"));
         
@@ -241,34 +412,268 @@ void grammar::params2code::write_and_close_current_output_file()
             }
         }
         
-        // writing the lines on file and out stream
+        // rendering the lines
         for(auto& line : lines) {
             std::string trimmed = line;
             boost::trim(trimmed);
             if (!trimmed.empty()) {
-                (*current_fout_) << line.substr(indentation);
-                stream_ << line.substr(indentation);
+                rendered << line.substr(indentation);
             }
-            (*current_fout_) << std::endl;
-            stream_ << std::endl;
+            rendered << std::endl;
         }
-        (*current_fout_) << std::endl;
-        stream_ << std::endl;
-        
+        rendered << std::endl;
+    }
+    return rendered.str();
+}
+
+void grammar::params2code::write_code(const std::string& code)
+{
+    (*current_fout_) << code;
+    stream_ << code;
+    Stats::count("bytes_written", code.size());
+}
+
+void grammar::params2code::write_and_close_current_output_file()
+{
+    // nothing to trace before the first output file is opened
+    Trace::span span("output", current_fout_->is_open() ? current_output_.string().c_str() : nullptr);
+    if (!code_.empty()) {
+        write_code(render_code());
         code_.clear();
     }
     current_fout_->close();
 }
 
+std::string grammar::params2code::cache_key(const pugi::xml_node& root) const
+{
+    // the parameters reachable from a root are those whose path starts with
+    // the name of the root (see walker::do_walk)
+    std::string prefix = root.name();
+    boost::replace_all(prefix, ":", "-");
+    std::vector<std::string> reachable;
+    for (auto& param : parameters_) {
+        if (under_root(param.first, prefix)) {
+            reachable.push_back(param.first + "=" + param.second);
+        }
+    }
+    std::sort(reachable.begin(), reachable.end());
+    // roots with the same name are told apart by their node, which is the
+    // same for all the candidates of a batch since they share the model
+    return prefix + "@" + std::to_string(root.hash_value()) + "\n" + boost::join(reachable, "\n");
+}
+
+std::vector<std::string> grammar::params2code::root_parameters(const pugi::xml_node& root) const
+{
+    std::string prefix = root.name();
+    boost::replace_all(prefix, ":", "-");
+    std::vector<std::string> names;
+    for (auto& param : parameters_) {
+        if (under_root(param.first, prefix)) {
+            names.push_back(param.first);
+        }
+    }
+    return names;
+}
+
+std::vector<std::string> grammar::params2code::consumed_parameters(const std::vector<std::string>& names) const
+{
+    std::vector<std::string> consumed;
+    for (auto& name : names) {
+        if (parameters_.count(name) == 0) {
+            consumed.push_back(name);
+        }
+    }
+    return consumed;
+}
+
+void grammar::params2code::consume_parameters(const std::vector<std::string>& names)
+{
+    // the parameters not used by the cached walk are left, so that they are
+    // reported as on a miss
+    for (auto& name : names) {
+        parameters_.erase(name);
+    }
+}
+
+const std::vector<boost::filesystem::path>& grammar::params2code::generated_files() const
+{
+    return files_;
+}
+
+void grammar::params2code::set_invariant_dir(boost::filesystem::path invariant_dir)
+{
+    invariant_dir_ = invariant_dir;
+}
+
+bool grammar::params2code::collect_invariant(const pugi::xml_node& node, std::string& text)
+{
+    // collects the cdatas until the first node that depends on a parameter
+    if (type(node) == grammar::walker::node_type::cdata) {
+        text += node.value();
+        return true;
+    } else if (type(node) == grammar::walker::node_type::plain) {
+        for (auto& child : node.children()) {
+            if (!collect_invariant(child, text)) {
+                return false;
+            }
+        }
+        return true;
+    } else if (type(node) == grammar::walker::node_type::call) {
+        pugi::xpath_query element_q(("/gr:grammar/gr:derivations/" + std::string(node.name())).c_str());
+        for (auto& element : Stats::xpath(element_q).evaluate_node_set(model_->grammar())) {
+            if (!collect_invariant(element.node(), text)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+std::string grammar::params2code::invariant_header(const boost::filesystem::path& output, const std::string& invariant)
+{
+    boost::filesystem::path header = boost::filesystem::absolute(invariant_dir_ / (output.string() + ".invariant.h"));
+    std::string code = render_code(invariant);
+    
+    // the header is shared by all candidates, it is written only if missing
+    // or if it was generated from a different grammar
+    std::ifstream fin(header.string());
+    std::ostringstream current;
+    current << fin.rdbuf();
+    fin.close();
+    if (current.str() != code) {
+        if (!boost::filesystem::is_directory(header.parent_path())) {
+            if(!boost::filesystem::create_directories(header.parent_path())) {
+                Error::fatal("Could not create " + header.parent_path().string() + ".");
+            }
+        }
+        Trace::span span("output", header.string().c_str());
+        std::ofstream fout(header.string());
+        if (!fout.good()) {
+            Error::fatal("Could not write " + header.string() + ".");
+        }
+        fout << code;
+        Stats::count("bytes_written", code.size());
+        stream_ << "Invariant code of " << output << " written to " << header << "\n" << std::endl;
+    }
+    // included relative to the output file, so that the directories can be
+    // moved together
+    return relative_path(header, (target_dir_ / output).parent_path()).generic_string();
+}
+
+void grammar::params2code::set_max_depth(int max_depth)
+{
+    max_depth_ = max_depth;
+}
+
+void grammar::params2code::set_cache(std::shared_ptr<code_cache> cache)
+{
+    cache_ = cache;
+}
+
+std::unique_ptr<grammar::params2code> grammar::params2code::root_worker(std::ostream& stream)
+{
+    std::unique_ptr<params2code> worker(new params2code(model_, parameters_, target_dir_, stream, do_not_reindent_));
+    worker->max_depth_ = max_depth_;
+    return worker;
+}
+
+void grammar::params2code::walk_roots(const std::vector<pugi::xml_node>& roots)
+{
+    std::vector<std::string> keys(roots.size());
+    std::vector<std::string> codes(roots.size());
+    std::vector<std::vector<std::string>> consumed(roots.size());
+    std::vector<bool> cached(roots.size(), false);
+    if (cache_) {
+        for (size_t i = 0; i < roots.size(); ++i) {
+            keys[i] = cache_key(roots[i]);
+            cached[i] = cache_->lookup(keys[i], codes[i], consumed[i]);
+        }
+    }
+
+    // the workers only walk, the code is rendered and written here in the
+    // order of the roots as if they had been walked one after the other
+    std::vector<std::unique_ptr<params2code>> workers(roots.size());
+    std::ostream null_stream(nullptr);
+    Workers::run(roots.size(), [&](size_t i) {
+        if (!cached[i]) {
+            workers[i] = root_worker(null_stream);
+            workers[i]->deferred_output_ = true;
+            workers[i]->walk(roots[i]);
+        }
+    });
+
+    for (size_t i = 0; i < roots.size(); ++i) {
+        output_file(roots[i].attribute("output").value());
+        if (cached[i]) {
+            consume_parameters(consumed[i]);
+            write_code(codes[i]);
+            continue;
+        }
+        code_.swap(workers[i]->code_);
+        // the parameters left by the worker were not used by its root
+        consumed[i] = workers[i]->consumed_parameters(root_parameters(roots[i]));
+        consume_parameters(consumed[i]);
+        workers[i].reset();
+        if (cache_) {
+            std::string code = render_code();
+            code_.clear();
+            cache_->store(keys[i], code, consumed[i]);
+            write_code(code);
+        }
+    }
+}
+
 void grammar::params2code::generate_code()
 {
     // files to be copied first
     copy_single_files();
     copy_files_with_filter();
 
+    // code generated under every configuration
+    if (!invariant_dir_.empty()) {
+        for (auto& root : output_roots()) {
+            boost::filesystem::path output(root.attribute("output").value());
+            if (!is_c_family(output)) {
+                continue;
+            }
+            std::string invariant;
+            collect_invariant(root, invariant);
+            invariant = invariant.substr(0, safe_split(invariant));
+            if (!boost::trim_copy(invariant).empty()) {
+                invariants_[output.generic_string()] = invariant;
+            }
+        }
+    }
+
     // generate other files
     parameters_bckp_ = parameters_;
-    walk();
+    std::vector<pugi::xml_node> roots = output_roots();
+    if (Workers::jobs() > 1 && roots.size() > 1 && independent_roots(roots)) {
+        walk_roots(roots);
+    } else {
+        for (auto& root : roots) {
+            if (!cache_) {
+                walk(root);
+                continue;
+            }
+            std::string key = cache_key(root);
+            std::string code;
+            std::vector<std::string> consumed;
+            if (cache_->lookup(key, code, consumed)) {
+                output_file(root.attribute("output").value());
+                consume_parameters(consumed);
+            } else {
+                std::vector<std::string> names = root_parameters(root);
+                walk(root);
+                code = render_code();
+                code_.clear();
+                consumed = consumed_parameters(names);
+                cache_->store(key, code, consumed);
+            }
+            write_code(code);
+        }
+    }
     for (auto& param : parameters_) {
         Error::warning("parameter \"" + param.first + " : " + param.second + \
                        "\" was not used during code generation.");
@@ -277,3 +682,31 @@ void grammar::params2code::generate_code()
     
     write_and_close_current_output_file();
 }
+
+bool grammar::code_cache::lookup(const std::string& key, std::string& code, std::vector<std::string>& consumed)
+{
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        ++misses_;
+        return false;
+    }
+    ++hits_;
+    code = it->second.code;
+    consumed = it->second.consumed;
+    return true;
+}
+
+void grammar::code_cache::store(const std::string& key, const std::string& code, const std::vector<std::string>& consumed)
+{
+    entries_[key] = entry{code, consumed};
+}
+
+long grammar::code_cache::hits() const
+{
+    return hits_;
+}
+
+long grammar::code_cache::misses() const
+{
+    return misses_;
+}
@@ -0,0 +1,154 @@
+//
+//  sampler.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+#include "basic_walker.hpp"
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/replace.hpp>
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+grammar::sampler::sampler(std::shared_ptr<grammar::model>& a_model, int max_depth, unsigned long seed) : basic_walker(a_model, max_depth), space_(a_model, max_depth), generator_(seed)
+{
+}
+
+void grammar::sampler::load_weights(const boost::filesystem::path& weights_file)
+{
+    std::ifstream fin(weights_file.string());
+    if (!fin.good()) {
+        Error::fatal("Could not open " + weights_file.string() + ".");
+    }
+    std::string line;
+    while (std::getline(fin, line)) {
+        std::istringstream tokens(line);
+        std::string rule;
+        if (!(tokens >> rule) || boost::starts_with(rule, "#")) {
+            continue;
+        }
+        std::vector<double> weights;
+        double weight;
+        while (tokens >> weight) {
+            if (weight < 0) {
+                Error::fatal("Negative weight for rule " + rule + ".");
+            }
+            weights.push_back(weight);
+        }
+        if (!tokens.eof()) {
+            Error::fatal("Cannot parse the weights of rule " + rule + ".");
+        }
+        weights_[rule] = weights;
+    }
+    distributions_.clear();
+}
+
+int grammar::sampler::choose(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    int level = type(node) == grammar::walker_base::node_type::recursive ? recursion_level(path, depth) : 0;
+    auto key = std::make_tuple(node.internal_object(), depth, level);
+    auto distribution = distributions_.find(key);
+    if (distribution == distributions_.end()) {
+        auto counts = space_.alternative_counts(node, depth, level);
+        auto weights = weights_.find(node.name());
+        if (weights != weights_.end() && weights->second.size() != counts.size()) {
+            Error::fatal("Rule " + std::string(node.name()) + " has " + std::to_string(counts.size()) + " alternatives but " +
+                         std::to_string(weights->second.size()) + " weights.");
+        }
+        // the counts may not fit in a double, they are scaled down so that
+        // the largest one has 62 significant bits
+        unsigned shift = 0;
+        for (auto& count : counts) {
+            if (count > 0 && boost::multiprecision::msb(count) > 62 + shift) {
+                shift = boost::multiprecision::msb(count) - 62;
+            }
+        }
+        std::vector<double> probabilities;
+        double total = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            double probability = static_cast<double>(counts[i] >> shift);
+            if (weights != weights_.end()) {
+                probability *= weights->second[i];
+            }
+            probabilities.push_back(probability);
+            total += probability;
+        }
+        if (total == 0) {
+            Error::fatal("No derivation with non-zero weight for '" + path + "'.");
+        }
+        distribution = distributions_.insert(std::make_pair(key, std::discrete_distribution<int>(probabilities.begin(), probabilities.end()))).first;
+    }
+    int choice = distribution->second(generator_);
+    space_.assign(assignment_, node, path, depth, choice);
+    return choice;
+}
+
+int grammar::sampler::callback_categorical(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    return choose(node, path, depth);
+}
+
+int grammar::sampler::callback_recursive(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    return choose(node, path, depth);
+}
+
+void grammar::sampler::callback_range(const pugi::xml_node& node, const std::string& path, int depth)
+{
+    std::string type = node.attribute("type").value();
+    if (type != "int" && type != "real") {
+        return;
+    }
+    if (!space_.assigned(node)) {
+        return;
+    }
+    double min = node.attribute("min").as_double();
+    double max = node.attribute("max").as_double();
+    std::string attribute = node.attribute("log-scale").value();
+    bool log_scale = boost::iequals(attribute, "true") || boost::iequals(attribute, "yes");
+    if (log_scale && min <= 0) {
+        Error::fatal("Log-scale range '" + path + "' with a non positive minimum.");
+    }
+
+    std::ostringstream value;
+    if (type == "int") {
+        long low = std::stol(node.attribute("min").value());
+        long high = std::stol(node.attribute("max").value());
+        long sampled;
+        if (log_scale) {
+            std::uniform_real_distribution<double> distribution(std::log(min), std::log(max + 1));
+            sampled = static_cast<long>(std::floor(std::exp(distribution(generator_))));
+            sampled = std::max(low, std::min(high, sampled));
+        } else {
+            sampled = std::uniform_int_distribution<long>(low, high)(generator_);
+        }
+        value << sampled;
+    } else if (log_scale) {
+        std::uniform_real_distribution<double> distribution(std::log(min), std::log(max));
+        value << std::min(max, std::exp(distribution(generator_)));
+    } else {
+        value << std::uniform_real_distribution<double>(min, max)(generator_);
+    }
+
+    std::string name = path;
+    boost::replace_all(name, ":", "-");
+    assignment_.push_back(std::make_pair(name, value.str()));
+}
+
+const std::vector<std::pair<std::string, std::string>>& grammar::sampler::sample()
+{
+    assignment_.clear();
+    space_.begin_assignment();
+    walk();
+    return assignment_;
+}
+
+template class grammar::basic_walker<grammar::sampler>;
@@ -10,6 +10,7 @@
 //
 
 #include "grammar.hpp"
+#include "basic_configuration.hpp"
 #include "error.hpp"
 
 #include <boost/algorithm/string/join.hpp>
@@ -51,11 +52,21 @@ void grammar::smac_conf::fmt_parameter(const std::string& rule_name, const std::
     }
 }
 
-void grammar::smac_conf::print(std::ostream& stream)
+void grammar::smac_conf::merge(smac_conf& worker)
 {
+    basic_configuration::merge(worker);
+    conditionals_.insert(conditionals_.end(), worker.conditionals_.begin(), worker.conditionals_.end());
+}
+
+void grammar::smac_conf::reset()
+{
+    basic_configuration::reset();
     conditionals_.clear();
-    
-    grammar::configuration::print(stream);
+}
+
+void grammar::smac_conf::write(std::ostream& stream)
+{
+    basic_configuration::write(stream);
 
     stream << "\nConditionals:" << std::endl;
     for (auto& conditional : conditionals_) {
@@ -63,4 +74,7 @@ void grammar::smac_conf::print(std::ostream& stream)
             stream << conditional << std::endl;
         }
     }
-}
\ No newline at end of file
+}
+
+template class grammar::basic_walker<grammar::smac_conf>;
+template class grammar::basic_configuration<grammar::smac_conf>;
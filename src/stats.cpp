@@ -0,0 +1,124 @@
+//
+//  stats.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "stats.hpp"
+#include "trace.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+#include <sys/resource.h>
+
+bool Stats::enabled = false;
+bool Stats::phase_open = false;
+std::string Stats::output = "";
+std::map<std::string, long> Stats::counters;
+std::vector<Stats::phase_stats> Stats::phases;
+std::chrono::steady_clock::time_point Stats::start;
+std::chrono::steady_clock::time_point Stats::phase_start;
+
+static std::mutex counters_mutex;
+
+// high water mark of the resident set since the start of the process
+static long peak_rss_kb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point time)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - time).count();
+}
+
+void Stats::enable(const std::string& file)
+{
+    if (!enabled) {
+        std::atexit(write_report);
+    }
+    enabled = true;
+    output = file;
+    start = std::chrono::steady_clock::now();
+}
+
+void Stats::phase(const std::string& name)
+{
+    Trace::phase(name);
+    if (!enabled) {
+        return;
+    }
+    end_phase();
+    phases.push_back(phase_stats{name, 0, 0});
+    phase_open = true;
+    phase_start = std::chrono::steady_clock::now();
+}
+
+void Stats::add(const char* counter, long amount)
+{
+    std::lock_guard<std::mutex> lock(counters_mutex);
+    counters[counter] += amount;
+}
+
+void Stats::end_phase()
+{
+    if (phase_open) {
+        phases.back().seconds = seconds_since(phase_start);
+        phases.back().peak_rss_kb = peak_rss_kb();
+        phase_open = false;
+    }
+}
+
+void Stats::report(std::ostream& stream)
+{
+    end_phase();
+    stream << "{" << std::endl;
+    stream << "  \"total_seconds\": " << seconds_since(start) << "," << std::endl;
+    stream << "  \"peak_rss_kb\": " << peak_rss_kb() << "," << std::endl;
+    stream << "  \"phases\": [" << std::endl;
+    for (size_t i = 0; i < phases.size(); ++i) {
+        stream << "    {\"name\": \"" << phases[i].name << "\", \"seconds\": " << phases[i].seconds;
+        stream << ", \"peak_rss_kb\": " << phases[i].peak_rss_kb << "}" << (i + 1 < phases.size() ? "," : "") << std::endl;
+    }
+    stream << "  ]," << std::endl;
+    stream << "  \"counters\": {";
+    // the counters are always reported, even if they are zero
+    const char* names[] = {"xpath_evaluations", "nodes_visited", "derivations_inlined", "parameters_emitted",
+                           "bytes_written", "files_copied"};
+    for (auto name : names) {
+        counters[name] += 0;
+    }
+    bool first = true;
+    for (auto& counter : counters) {
+        stream << (first ? "" : ",") << std::endl << "    \"" << counter.first << "\": " << counter.second;
+        first = false;
+    }
+    stream << std::endl << "  }" << std::endl << "}" << std::endl;
+}
+
+void Stats::write_report()
+{
+    if (output == "-") {
+        report(std::cerr);
+        return;
+    }
+    std::ofstream fout(output);
+    if (fout.good()) {
+        report(fout);
+    } else {
+        std::cerr << "Could not write the stats to " << output << "." << std::endl;
+    }
+}
@@ -0,0 +1,70 @@
+//
+//  stats.hpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#ifndef __Grammar2Code__Stats__
+#define __Grammar2Code__Stats__
+
+#include "pugixml.hpp"
+
+#include <chrono>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// wall time and peak memory of the phases of a run, along with some counters;
+// nothing is recorded until enable is called
+class Stats {
+public:
+    // the report is written as JSON at exit in file, or on the standard error
+    // if file is "-"
+    static void enable(const std::string& file);
+
+    // ends the current phase, if any, and starts a new one (also in the trace)
+    static void phase(const std::string& name);
+
+    static void count(const char* counter, long amount = 1)
+    {
+        if (enabled) {
+            add(counter, amount);
+        }
+    }
+
+    // counts the evaluation of the query
+    static const pugi::xpath_query& xpath(const pugi::xpath_query& query)
+    {
+        count("xpath_evaluations");
+        return query;
+    }
+
+    static void report(std::ostream& stream);
+
+private:
+    struct phase_stats {
+        std::string name;
+        double seconds;
+        long peak_rss_kb;
+    };
+
+    static bool enabled;
+    static bool phase_open;
+    static std::string output;
+    static std::map<std::string, long> counters;
+    static std::vector<phase_stats> phases;
+    static std::chrono::steady_clock::time_point start;
+    static std::chrono::steady_clock::time_point phase_start;
+
+    static void end_phase();
+
+    // the counters are shared by the workers
+    static void add(const char* counter, long amount);
+
+    static void write_report();
+};
+
+#endif /* defined(__Grammar2Code__Stats__) */
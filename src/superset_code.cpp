@@ -0,0 +1,345 @@
+//
+//  superset_code.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "error.hpp"
+
+#include <boost/algorithm/string/erase.hpp>
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
+
+#include <string>
+#include <vector>
+
+#define RUNTIME_NAME "g2c_runtime"
+
+// the parameters are read at runtime by the generated program
+static std::unordered_map<std::string, std::string> no_parameters;
+
+// tells whether the code generated so far in the current file ends at the
+// beginning of a statement inside a function body; strings, characters and
+// comments are skipped, and the end of a preprocessor directive is also the
+// beginning of a statement
+static bool at_statement_level(const std::string& code)
+{
+    int braces = 0;
+    char last = 0;
+    bool directive = false;
+    bool line_start = true;
+    for (size_t i = 0; i < code.size(); ++i) {
+        char c = code[i];
+        if (c == '/' && i + 1 < code.size() && code[i + 1] == '*') {
+            size_t end = code.find("*/", i + 2);
+            if (end == std::string::npos) {
+                return false;
+            }
+            i = end + 1;
+            continue;
+        }
+        if (c == '/' && i + 1 < code.size() && code[i + 1] == '/') {
+            i = code.find('\n', i);
+            if (i == std::string::npos) {
+                return false;
+            }
+            --i;
+            continue;
+        }
+        if (c == '"' || c == '\'') {
+            size_t j = i + 1;
+            while (j < code.size() && code[j] != c) {
+                j += (code[j] == '\\') ? 2 : 1;
+            }
+            if (j >= code.size()) {
+                return false;
+            }
+            i = j;
+            last = c;
+            line_start = false;
+            continue;
+        }
+        if (c == '\n') {
+            if (directive && (i == 0 || code[i - 1] != '\\')) {
+                directive = false;
+                last = ';';
+            }
+            line_start = true;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r') {
+            continue;
+        }
+        if (line_start && c == '#') {
+            directive = true;
+        }
+        line_start = false;
+        if (directive) {
+            continue;
+        }
+        if (c == '{') {
+            ++braces;
+        } else if (c == '}') {
+            --braces;
+        }
+        last = c;
+    }
+    return !directive && braces > 0 && (last == ';' || last == '{' || last == '}' || last == ':');
+}
+
+grammar::superset_code::superset_code(std::shared_ptr<grammar::model>& a_model, int max_depth, boost::filesystem::path target_dir, std::ostream& stream, bool do_not_reindent) : params2code(a_model, no_parameters, target_dir, stream, do_not_reindent)
+{
+    max_depth_ = max_depth;
+}
+
+void grammar::superset_code::generate_code()
+{
+    params2code::generate_code();
+    write_runtime();
+}
+
+std::unique_ptr<grammar::params2code> grammar::superset_code::root_worker(std::ostream& stream)
+{
+    return std::unique_ptr<params2code>(new superset_code(model_, max_depth_, target_dir_, stream, do_not_reindent_));
+}
+
+std::string grammar::superset_code::render_code()
+{
+    std::string code = params2code::render_code();
+    if (!code.empty() && is_c_family(current_output_)) {
+        code = "#include \"" + std::string(RUNTIME_NAME) + ".h\"\n" + code;
+    }
+    return code;
+}
+
+int grammar::superset_code::dispatch(const pugi::xml_node& node, std::string path, int depth)
+{
+    if (strcmp(node.attribute("output").value(), "")) {
+        output_file(node.attribute("output").value());
+    }
+    boost::replace_all(path, ":", "-");
+    std::string code = boost::join(code_, "");
+    if (!at_statement_level(code)) {
+        Error::fatal("The choice '" + path + "' in " + current_output_.string() + \
+                     " is not at the beginning of a statement inside a function and cannot be dispatched at runtime.");
+    }
+
+    // the switch is indented as the line where the choice is, so that the
+    // generated code can be re-indented as the rest of the file
+    std::string line = code.substr(code.find_last_of('\n') + 1);
+    std::string ind = line.substr(0, line.find_first_not_of(" \t"));
+    indentations_.push_back(ind);
+    open_cases_.push_back(false);
+    dispatched_.push_back(true);
+
+    // a list-like recursion can also be given by its count (path@reps),
+    // which is used when the parameter of the level is missing
+    std::string read = "g2c_categorical(\"" + path + "\")";
+    int recursive = type(node) == grammar::walker::node_type::recursive ? list_recursion(node) : -1;
+    if (recursive != -1) {
+        std::string parent = path;
+        boost::erase_last(parent, "@" + std::to_string(depth));
+        read = "g2c_recursive(\"" + path + "\", \"" + parent + "@reps\", " + \
+               std::to_string(recursion_level(path, depth)) + ", " + std::to_string(recursive) + ")";
+    }
+
+    // the value of the parameter is read once for each choice
+    code_.push_back("\n" + ind + "{\n");
+    code_.push_back(ind + "    static int g2c_choice = -1;\n");
+    code_.push_back(ind + "    if (g2c_choice < 0) {\n");
+    code_.push_back(ind + "        g2c_choice = " + read + ";\n");
+    code_.push_back(ind + "    }\n");
+    code_.push_back(ind + "    switch (g2c_choice) {\n");
+
+    // all choices are walked
+    return -1;
+}
+
+int grammar::superset_code::callback_categorical(const pugi::xml_node& node, std::string path, int depth)
+{
+    return dispatch(node, path, depth);
+}
+
+int grammar::superset_code::callback_recursive(const pugi::xml_node& node, std::string path, int depth)
+{
+    // the last level is folded in the configurations when only the base
+    // alternative is left, which is then generated without a switch
+    int base = base_alternative(node);
+    if (base != -1 && remaining_levels(node, recursion_level(path, depth), depth) <= 1) {
+        if (strcmp(node.attribute("output").value(), "")) {
+            output_file(node.attribute("output").value());
+        }
+        dispatched_.push_back(false);
+        return base;
+    }
+    return dispatch(node, path, depth);
+}
+
+void grammar::superset_code::callback_range(const pugi::xml_node& node, std::string path, int depth)
+{
+    boost::replace_all(path, ":", "-");
+    std::string type = node.attribute("type").value();
+    if (fixed_range(node)) {
+        // folded in the configurations
+        code_.push_back(node.attribute("min").value());
+    } else if (type == "int") {
+        code_.push_back("g2c_int(\"" + path + "\")");
+    } else if (type == "real") {
+        code_.push_back("g2c_real(\"" + path + "\")");
+    } else {
+        Error::fatal("The range '" + path + "' of type " + type + " cannot be read at runtime.");
+    }
+}
+
+void grammar::superset_code::callback_alternative(const pugi::xml_node& node, std::string path, int depth, int alternative)
+{
+    if (!dispatched_.back()) {
+        return;
+    }
+    const std::string& ind = indentations_.back();
+    if (open_cases_.back()) {
+        code_.push_back("\n" + ind + "        break;\n" + ind + "    }\n");
+    }
+    code_.push_back(ind + "    case " + std::to_string(alternative) + ": {\n" + ind + "        ");
+    open_cases_.back() = true;
+}
+
+void grammar::superset_code::callback_end_choice(const pugi::xml_node& node, std::string path, int depth)
+{
+    if (!dispatched_.back()) {
+        dispatched_.pop_back();
+        return;
+    }
+    dispatched_.pop_back();
+    const std::string& ind = indentations_.back();
+    if (open_cases_.back()) {
+        code_.push_back("\n" + ind + "        break;\n" + ind + "    }\n");
+    }
+    boost::replace_all(path, ":", "-");
+    code_.push_back(ind + "    default:\n" + ind + "        g2c_invalid(\"" + path + "\");\n");
+    code_.push_back(ind + "    }\n" + ind + "}\n" + ind);
+    open_cases_.pop_back();
+    indentations_.pop_back();
+}
+
+void grammar::superset_code::write_runtime()
+{
+    boost::filesystem::path header = boost::filesystem::absolute(target_dir_ / (std::string(RUNTIME_NAME) + ".h"));
+    std::ofstream fheader(header.string());
+    if (!fheader.good()) {
+        Error::fatal("Could not write " + header.string() + ".");
+    }
+    fheader << R"(/* This file has been generated by grammar2code. */
+#ifndef G2C_RUNTIME_H
+#define G2C_RUNTIME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* stores the command line with the --parameter=value pairs of the algorithm */
+void g2c_init(int argc, char **argv);
+
+int g2c_categorical(const char *name);
+
+/* choice of a level of a list-like recursion, from the parameter of the level
+   or else from the count of the recursion */
+int g2c_recursive(const char *name, const char *count, int level, int recursive);
+
+long g2c_int(const char *name);
+
+double g2c_real(const char *name);
+
+void g2c_invalid(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+)";
+    fheader.close();
+    files_.push_back(std::string(RUNTIME_NAME) + ".h");
+
+    boost::filesystem::path source = boost::filesystem::absolute(target_dir_ / (std::string(RUNTIME_NAME) + ".c"));
+    std::ofstream fsource(source.string());
+    if (!fsource.good()) {
+        Error::fatal("Could not write " + source.string() + ".");
+    }
+    fsource << R"(/* This file has been generated by grammar2code. */
+#include ")" << RUNTIME_NAME << R"(.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int g2c_argc = 0;
+static char **g2c_argv = NULL;
+
+void g2c_init(int argc, char **argv)
+{
+    g2c_argc = argc;
+    g2c_argv = argv;
+}
+
+static const char *g2c_find(const char *name)
+{
+    size_t length = strlen(name);
+    int i;
+    for (i = 1; i < g2c_argc; ++i) {
+        const char *arg = g2c_argv[i];
+        if (!strncmp(arg, "--", 2) && !strncmp(arg + 2, name, length) && arg[2 + length] == '=') {
+            return arg + 3 + length;
+        }
+    }
+    return NULL;
+}
+
+static const char *g2c_value(const char *name)
+{
+    const char *value = g2c_find(name);
+    if (value == NULL) {
+        fprintf(stderr, "No parameter to translate '%s'.\n", name);
+        exit(EXIT_FAILURE);
+    }
+    return value;
+}
+
+int g2c_categorical(const char *name)
+{
+    return atoi(g2c_value(name));
+}
+
+int g2c_recursive(const char *name, const char *count, int level, int recursive)
+{
+    const char *reps = g2c_find(name) == NULL ? g2c_find(count) : NULL;
+    if (reps == NULL) {
+        return g2c_categorical(name);
+    }
+    return level < atoi(reps) ? recursive : 1 - recursive;
+}
+
+long g2c_int(const char *name)
+{
+    return atol(g2c_value(name));
+}
+
+double g2c_real(const char *name)
+{
+    return atof(g2c_value(name));
+}
+
+void g2c_invalid(const char *name)
+{
+    fprintf(stderr, "Invalid value '%s' for parameter '%s'.\n", g2c_value(name), name);
+    exit(EXIT_FAILURE);
+}
+)";
+    fsource.close();
+    files_.push_back(std::string(RUNTIME_NAME) + ".c");
+    stream_ << "Runtime for reading the parameters written to " << header << " and " << source << "\n" << std::endl;
+}
@@ -0,0 +1,116 @@
+//
+//  trace.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "trace.hpp"
+#include "error.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+
+bool Trace::active = false;
+bool Trace::first_event = true;
+std::ofstream Trace::output;
+std::chrono::steady_clock::time_point Trace::start;
+Trace::span* Trace::current_phase = nullptr;
+
+static std::mutex output_mutex;
+
+static std::string json_escape(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+void Trace::enable(const std::string& file)
+{
+    if (active) {
+        return;
+    }
+    output.open(file);
+    if (!output.good()) {
+        Error::fatal("Could not write " + file + ".");
+    }
+    output << "[";
+    std::atexit(close);
+    start = std::chrono::steady_clock::now();
+    // the main thread is the first one
+    thread_id();
+    active = true;
+}
+
+void Trace::phase(const std::string& name)
+{
+    if (!active) {
+        return;
+    }
+    delete current_phase;
+    current_phase = new span("phase", name.c_str());
+}
+
+void Trace::span::begin(const char* category, const char* name, int depth)
+{
+    category_ = category;
+    name_ = name;
+    depth_ = depth;
+    start_ = std::chrono::steady_clock::now();
+}
+
+void Trace::span::end()
+{
+    Trace::write_event(category_, name_, depth_, start_, std::chrono::steady_clock::now());
+}
+
+int Trace::thread_id()
+{
+    static std::atomic<int> threads(0);
+    static thread_local int id = ++threads;
+    return id;
+}
+
+void Trace::write_event(const char* category, const std::string& name, int depth,
+                        std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+    std::lock_guard<std::mutex> lock(output_mutex);
+    if (!active) {
+        return;
+    }
+    typedef std::chrono::duration<double, std::micro> microseconds;
+    output << (first_event ? "\n" : ",\n");
+    first_event = false;
+    output << "{\"name\": \"" << json_escape(name) << "\", \"cat\": \"" << category << "\", \"ph\": \"X\"";
+    output << ", \"ts\": " << microseconds(begin - start).count() << ", \"dur\": " << microseconds(end - begin).count();
+    output << ", \"pid\": 1, \"tid\": " << thread_id();
+    if (depth >= 0) {
+        output << ", \"args\": {\"depth\": " << depth << "}";
+    }
+    output << "}";
+}
+
+void Trace::close()
+{
+    delete current_phase;
+    current_phase = nullptr;
+    std::lock_guard<std::mutex> lock(output_mutex);
+    output << "\n]\n";
+    output.close();
+    active = false;
+}
@@ -0,0 +1,81 @@
+//
+//  trace.hpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#ifndef __Grammar2Code__Trace__
+#define __Grammar2Code__Trace__
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+// spans of a run written as Chrome trace events (chrome://tracing, Perfetto);
+// nothing is recorded until enable is called
+class Trace {
+public:
+    // the events are written in file as they end, the file is closed at exit
+    static void enable(const std::string& file);
+
+    static bool enabled()
+    {
+        return active;
+    }
+
+    // ends the current phase, if any, and starts a new one
+    static void phase(const std::string& name);
+
+    // a span from its construction to its destruction, the name is copied
+    // only when tracing is enabled and a null name records nothing
+    class span {
+    public:
+        span(const char* category, const char* name, int depth = -1) : active_(Trace::active && name != nullptr)
+        {
+            if (active_) {
+                begin(category, name, depth);
+            }
+        }
+
+        ~span()
+        {
+            if (active_) {
+                end();
+            }
+        }
+
+    private:
+        bool active_;
+        const char* category_;
+        std::string name_;
+        int depth_;
+        std::chrono::steady_clock::time_point start_;
+
+        span(const span&);
+        span& operator=(const span&);
+
+        void begin(const char* category, const char* name, int depth);
+
+        void end();
+    };
+
+private:
+    static bool active;
+    static bool first_event;
+    static std::ofstream output;
+    static std::chrono::steady_clock::time_point start;
+    static span* current_phase;
+
+    // the events of the workers are written along with the ones of the main
+    // thread, each with the index of its thread
+    static int thread_id();
+
+    static void write_event(const char* category, const std::string& name, int depth,
+                            std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+    static void close();
+};
+
+#endif /* defined(__Grammar2Code__Trace__) */
@@ -0,0 +1,144 @@
+//
+//  walk_cursor.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "grammar.hpp"
+#include "walk_cursor.hpp"
+#include "error.hpp"
+#include "stats.hpp"
+
+#include <boost/algorithm/string/erase.hpp>
+
+grammar::walk_cursor::walk_cursor(std::shared_ptr<grammar::model>& a_model, int max_depth) : walker_base(a_model, max_depth)
+{
+    expansion_.pending = false;
+}
+
+grammar::walk_cursor::walk_cursor(const walk_cursor& other) : walker_base(other)
+{
+    expansion_.pending = false;
+}
+
+void grammar::walk_cursor::set_max_depth(int max_depth)
+{
+    max_depth_ = max_depth;
+}
+
+void grammar::walk_cursor::begin_walk()
+{
+    walks_.push_back(walk{frames_.size(), expansion_});
+    expansion_.pending = false;
+}
+
+void grammar::walk_cursor::start()
+{
+    begin_walk();
+    const std::vector<unsigned>& roots = model_->lowered().roots();
+    for (size_t i = roots.size(); i-- > 0; ) {
+        push(frame::visit_root, roots[i], 0, -1, "");
+    }
+}
+
+void grammar::walk_cursor::start(const pugi::xml_node& root)
+{
+    begin_walk();
+    push(frame::visit_root, model_->lowered().id(root), 0, -1, "");
+}
+
+void grammar::walk_cursor::select(int alternative)
+{
+    expansion_.selected = alternative;
+}
+
+void grammar::walk_cursor::stop()
+{
+    if (walks_.empty()) {
+        return;
+    }
+    expansion_.pending = false;
+    while (frames_.size() > walks_.back().base) {
+        if (frames_.back().step == frame::end_span) {
+            spans_.pop_back();
+        }
+        paths_.resize(frames_.back().path);
+        frames_.pop_back();
+    }
+}
+
+// pushes the children of the node of the last event in reverse order, so
+// that they are visited in the order of the grammar
+void grammar::walk_cursor::expand()
+{
+    expansion_.pending = false;
+    const grammar::ir& ir = model_->lowered();
+    unsigned id = expansion_.id;
+    int depth = expansion_.depth;
+    const std::string& parent = expansion_.parent;
+    const grammar::ir::node& current = ir.at(id);
+    const pugi::xml_node& node = current.xml;
+    if (current.type == grammar::walker_base::node_type::call) {
+        const std::string& name = ir.name(current.name);
+        std::string path = parent + "%" + name;
+        grammar::ir::slice definitions = ir.definitions(current.name);
+        if (definitions.size == 0) {
+            Error::fatal("No definition for " + name + ".");
+        }
+        if (Trace::enabled()) {
+            spans_.push_back(std::unique_ptr<Trace::span>(new Trace::span("derivation", name.c_str(), depth)));
+            push(frame::end_span, id, depth, -1, "");
+        }
+        for (unsigned i = definitions.size; i-- > 0; ) {
+            push(frame::visit, ir.definition_at(definitions.first + i), depth, -1, path);
+        }
+    } else if (current.type == grammar::walker_base::node_type::categorical) {
+        push(frame::end_choice, id, depth, -1, parent);
+        for (unsigned count = current.alternatives.size; count-- > 0; ) {
+            if (expansion_.selected != -1 && expansion_.selected != static_cast<int>(count)) {
+                continue;
+            }
+            const grammar::ir::alternative& choice = ir.alternative_at(current.alternatives.first + count);
+            std::string path = parent + "%" + std::to_string(count);
+            for (unsigned i = choice.children.size; i-- > 0; ) {
+                push(frame::visit, ir.child_at(choice.children.first + i), depth, -1, path);
+            }
+            push(frame::begin_alternative, id, depth, count, parent);
+        }
+    } else if (current.type == grammar::walker_base::node_type::recursive) {
+        std::string level = parent + "@" + std::to_string(depth);
+        push(frame::end_choice, id, depth, -1, level);
+        for (unsigned count = current.alternatives.size; count-- > 0; ) {
+            if (expansion_.selected != -1 && expansion_.selected != static_cast<int>(count)) {
+                continue;
+            }
+            // the recursive alternative is walked only below the depth limit
+            const grammar::ir::alternative& choice = ir.alternative_at(current.alternatives.first + count);
+            if (choice.recursive && remaining_levels(node, recursion_level(level, depth), depth) <= 1) {
+                continue;
+            }
+            std::string path = level + "%" + std::to_string(count);
+            for (unsigned i = choice.children.size; i-- > 0; ) {
+                unsigned child = ir.child_at(choice.children.first + i);
+                if (ir.at(child).name == current.name) {
+                    std::string recursion = parent;
+                    boost::erase_last(recursion, "%" + ir.name(current.name));
+                    push(frame::visit, child, depth + 1, -1, recursion);
+                } else {
+                    push(frame::visit, child, depth + 1, -1, path);
+                }
+            }
+            push(frame::begin_alternative, id, depth, count, level);
+        }
+    } else if (current.type == grammar::walker_base::node_type::plain) {
+        // a node at the root of a series of derivation (with the output
+        // attribute) starts the path of its children
+        std::string path = parent.empty() ? std::string(node.name()) : parent + "%";
+        const grammar::ir::alternative& children = ir.alternative_at(current.alternatives.first);
+        for (unsigned i = children.children.size; i-- > 0; ) {
+            push(frame::visit, ir.child_at(children.children.first + i), depth, -1, path);
+        }
+    }
+}
@@ -0,0 +1,116 @@
+//
+//  walk_cursor.hpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+// members of grammar::walk_cursor on the path of every event, included by the
+// translation units that pull the events so that they can be inlined in their
+// loops; the children of a node are pushed out of line (walk_cursor.cpp)
+
+#ifndef __Grammar2Code__WalkCursor__
+#define __Grammar2Code__WalkCursor__
+
+#include "grammar.hpp"
+#include "stats.hpp"
+
+inline void grammar::walk_cursor::push(frame::step_type step, unsigned id, int depth, int alternative, const std::string& path)
+{
+    frames_.push_back(frame{step, alternative, id, depth, static_cast<unsigned>(paths_.size()), static_cast<unsigned>(path.size())});
+    paths_ += path;
+}
+
+inline bool grammar::walk_cursor::next()
+{
+    if (walks_.empty()) {
+        return false;
+    }
+    if (expansion_.pending) {
+        expand();
+    }
+    const grammar::ir& ir = model_->lowered();
+    while (frames_.size() > walks_.back().base) {
+        frame step = frames_.back();
+        frames_.pop_back();
+        event_.path.assign(paths_, step.path, step.length);
+        paths_.resize(step.path);
+        const grammar::ir::node& current = ir.at(step.id);
+        event_.node = current.xml;
+        event_.depth = step.depth;
+        event_.alternative = -1;
+        event_.recursive = false;
+
+        switch (step.step) {
+            case frame::visit_root:
+                event_.type = event::output;
+                push(frame::visit, step.id, step.depth, -1, event_.path);
+                return true;
+            case frame::begin_alternative:
+                event_.type = event::begin_alternative;
+                event_.alternative = step.alternative;
+                return true;
+            case frame::end_choice:
+                event_.type = event::end_choice;
+                return true;
+            case frame::end_span:
+                spans_.pop_back();
+                continue;
+            case frame::visit:
+                break;
+        }
+
+        Stats::count("nodes_visited");
+        // the strings of the event and of the expansion keep their buffers
+        // from one event to the next
+        expansion_.pending = false;
+        expansion_.id = step.id;
+        expansion_.depth = step.depth;
+        expansion_.parent.assign(event_.path);
+        expansion_.selected = -1;
+        switch (current.type) {
+            case grammar::walker_base::node_type::call:
+                event_.type = event::call;
+                expansion_.pending = true;
+                break;
+            case grammar::walker_base::node_type::categorical:
+            case grammar::walker_base::node_type::recursive:
+                // if node is at the root of a series of derivation (attribute
+                // output) and is transformed to a parameter (categorical or
+                // recursive), it should have a parameter name
+                if (expansion_.parent.empty()) {
+                    expansion_.parent = event_.node.name();
+                }
+                event_.type = event::choice;
+                event_.recursive = current.type == grammar::walker_base::node_type::recursive;
+                event_.alternative = current.alternatives.size;
+                event_.path.assign(expansion_.parent);
+                if (event_.recursive) {
+                    event_.path += '@';
+                    event_.path += std::to_string(step.depth);
+                }
+                expansion_.pending = true;
+                break;
+            case grammar::walker_base::node_type::range:
+                event_.type = event::range;
+                break;
+            case grammar::walker_base::node_type::copy:
+                event_.type = event::copy;
+                break;
+            case grammar::walker_base::node_type::cdata:
+                event_.type = event::cdata;
+                break;
+            case grammar::walker_base::node_type::plain:
+                event_.type = event::plain;
+                expansion_.pending = true;
+                break;
+        }
+        return true;
+    }
+    expansion_ = walks_.back().suspended;
+    walks_.pop_back();
+    return false;
+}
+
+#endif /* defined(__Grammar2Code__WalkCursor__) */
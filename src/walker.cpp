@@ -11,54 +11,120 @@
 
 #include "grammar.hpp"
 #include "error.hpp"
+#include "stats.hpp"
+#include "basic_walker.hpp"
 
 #include <boost/algorithm/string/erase.hpp>
 
-grammar::walker::walker(std::shared_ptr<grammar::model>& a_model, int max_depth) : model_{a_model}, max_depth_{max_depth}
+#include <cstdlib>
+
+grammar::walker_base::walker_base(std::shared_ptr<grammar::model>& a_model, int max_depth) : model_{a_model}, max_depth_{max_depth}
 {   
 }
 
+grammar::walker::walker(std::shared_ptr<grammar::model>& a_model, int max_depth) : basic_walker(a_model, max_depth)
+{
+}
+
 grammar::walker::~walker()
 {
 }
 
-bool grammar::walker::has_children(const pugi::xml_node& node) const
+bool grammar::walker_base::has_children(const pugi::xml_node& node) const
 {
     return node.children().begin() != node.children().end();
 }
 
-bool grammar::walker::has_attributes(const pugi::xml_node& node) const
+bool grammar::walker_base::has_attributes(const pugi::xml_node& node) const
 {
     return node.attributes().begin() != node.attributes().end();
 }
 
-grammar::walker::node_type grammar::walker::type(const pugi::xml_node& node)
+grammar::walker_base::node_type grammar::walker_base::type(const pugi::xml_node& node)
 {
-    if (!has_children(node) && !has_attributes(node) && strcmp(node.name(), "or") && node.type() != pugi::node_cdata) {
-        return grammar::walker::node_type::call;
-    } else if (!has_children(node) && has_attributes(node) && strcmp(node.attribute("type").value(), "")) {
-        return grammar::walker::node_type::range;
-    } else if (!strcmp(node.name(), "gr:copy")) {
-        return grammar::walker::node_type::copy;
-    } else if (node.type() == pugi::node_cdata) {
-        return grammar::walker::node_type::cdata;
-    } else if (has_children(node)) {
-        for (auto& child : node.children()) {
+    return grammar::ir::classify(node);
+}
+
+int grammar::walker_base::remaining_levels(const pugi::xml_node& node, int level, int depth) const
+{
+    pugi::xml_attribute attribute = node.attribute("max-depth");
+    if (!attribute) {
+        return max_depth_ - depth;
+    }
+    if (attribute.as_int() < 1) {
+        Error::fatal("Invalid max-depth '" + std::string(attribute.value()) + "' for " + node.name() + ".");
+    }
+    return attribute.as_int() - level;
+}
+
+int grammar::walker_base::recursion_level(const std::string& path, int depth)
+{
+    std::string parent = path.substr(0, path.rfind('@'));
+    size_t at = parent.rfind('@');
+    if (at == std::string::npos) {
+        return depth;
+    }
+    return depth - std::atoi(parent.c_str() + at + 1) - 1;
+}
+
+int grammar::walker_base::list_recursion(const pugi::xml_node& node)
+{
+    if (type(node) != grammar::walker_base::node_type::recursive) {
+        return -1;
+    }
+    auto choices = get_choice(node.children());
+    if (choices.size() != 2) {
+        return -1;
+    }
+    int recursive = -1;
+    for (size_t i = 0; i < choices.size(); ++i) {
+        int calls = 0;
+        for (auto& child : choices[i]) {
             if (!strcmp(child.name(), node.name())) {
-                return grammar::walker::node_type::recursive;
+                ++calls;
             }
         }
+        if (calls > 1 || (calls == 1 && recursive != -1)) {
+            return -1;
+        } else if (calls == 1) {
+            recursive = i;
+        }
     }
-    // checking if there are choices
-    for (auto& child : node.children()) {
-        if (!strcmp(child.name(), "or")) {
-            return grammar::walker::node_type::categorical;
+    return recursive;
+}
+
+int grammar::walker_base::base_alternative(const pugi::xml_node& node)
+{
+    int base = -1;
+    int count = 0;
+    for (auto& choice : get_choice(node.children())) {
+        bool recursive = false;
+        for (auto& child : choice) {
+            if (!strcmp(child.name(), node.name())) {
+                recursive = true;
+            }
         }
+        if (!recursive) {
+            if (base != -1) {
+                return -1;
+            }
+            base = count;
+        }
+        ++count;
     }
-    return grammar::walker::node_type::plain;
+    return base;
 }
 
-std::vector<std::vector<pugi::xml_node>> grammar::walker::get_choice(pugi::xml_object_range<pugi::xml_node_iterator> children)
+bool grammar::walker_base::fixed_range(const pugi::xml_node& node) const
+{
+    try {
+        return std::stod(node.attribute("min").value()) == std::stod(node.attribute("max").value());
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+std::vector<std::vector<pugi::xml_node>> grammar::walker_base::get_choice(pugi::xml_object_range<pugi::xml_node_iterator> children)
 {
     int count = 0;
     for (auto& child : children) {
@@ -78,113 +144,33 @@ std::vector<std::vector<pugi::xml_node>> grammar::walker::get_choice(pugi::xml_o
     return results;
 }
 
-void grammar::walker::do_walk(const pugi::xml_node& node, std::string parent, int depth)
+void grammar::walker::callback_alternative(const pugi::xml_node& node, std::string path, int depth, int alternative)
+{
+}
+
+void grammar::walker::callback_end_choice(const pugi::xml_node& node, std::string path, int depth)
 {
-    if (type(node) == grammar::walker::node_type::call) {
-        callback_call(node, parent, depth);
-        std::string name = node.name();
-        std::string path = parent + "%" + name;
-        pugi::xpath_query element_q(("/gr:grammar/gr:derivations/" + name).c_str());
-        const auto &iter = element_q.evaluate_node_set(model_->grammar());
-        if (iter.size() == 0) {
-            Error::fatal("No definition for " + name + ".");
-        }
-        for (auto& element : iter) {
-            do_walk(element.node(), path, depth);
-        }
-    } else if (type(node) == grammar::walker::node_type::categorical) {
-        // if node is at the root of a series of derivation (attribute output)
-        // and is transformed to a parameter (categorical or recursive), it
-        // should have a parameter name
-        if (parent.empty()) {
-            parent = node.name();
-        }
-        int callback_choice = callback_categorical(node, parent, depth);
-        auto choices = get_choice(node.children());
-        int count = 0;
-        for (auto& choice : choices) {
-            if (callback_choice != -1 && callback_choice != count) {
-                ++count;
-                continue;
-            }
-            for (auto& child : choice) {
-                std::string path = parent + "%" + std::to_string(count);
-                do_walk(child, path, depth);
-            }
-            ++count;
-        }
-    } else if (type(node) == grammar::walker::node_type::recursive) {
-        // if node is at the root of a series of derivation (attribute output)
-        // and is transformed to a parameter (categorical or recursive), it
-        // should have a parameter name
-        if (parent.empty()) {
-            parent = node.name();
-        }
-        int callback_choice = callback_recursive(node, parent + "@" + std::to_string(depth), depth);
-        auto choices = get_choice(node.children());        
-        int count = 0;
-        for (auto& choice : choices) {
-            if (callback_choice != -1 && callback_choice != count) {
-                ++count;
-                continue;
-            }
-            // check if this is the recursive rule
-            bool recursive = false;
-            for (auto& child : choice){
-                if (!strcmp(child.name(), node.name())) {
-                    recursive = true;
-                }
-            }
-            if (recursive) {
-                if (depth + 1 < max_depth_) {
-                    for (auto& child : choice) {
-                        if (!strcmp(child.name(), node.name())) {
-                            std::string path = parent;
-                            std::string name = node.name();
-                            boost::erase_last(path, "%" + name);
-                            do_walk(child, path, depth + 1);
-                        } else {
-                            std::string path = parent + "@" + std::to_string(depth) + "%" + std::to_string(count);
-                            do_walk(child, path, depth + 1);
-                        }
-                    } 
-                }
-            } else {
-                for (auto& child : choice){
-                    std::string path = parent + "@" + std::to_string(depth) + "%" + std::to_string(count);
-                    do_walk(child, path, depth + 1);
-                }
-            }
-            ++count;
-        }
-    } else if (type(node) == grammar::walker::node_type::range) {
-        callback_range(node, parent, depth);
-    } else if (type(node) == grammar::walker::node_type::copy) {
-        callback_copy(node, parent, depth);
-    } else if (type(node) == grammar::walker::node_type::cdata) {
-        callback_cdata(node, parent, depth);
-    } else if (type(node) == grammar::walker::node_type::plain) {
-        callback_plain(node, parent, depth);
-        for (auto&child : node.children()) {
-            if (strcmp(child.name(), "or")) {
-                std::string path;
-                if (!parent.empty()) {
-                    path = parent + "%";
-                } else {
-                    // node is at the root of a series of derivation
-                    // (has the output attribute)
-                    path += node.name();
-                }
-                do_walk(child, path, depth);
-            }
-        }
-    }
 }
 
-void grammar::walker::walk()
+std::vector<pugi::xml_node> grammar::walker_base::output_roots()
 {
+    std::vector<pugi::xml_node> roots;
     pugi::xpath_query all_elements("/gr:grammar/gr:derivations/*[@output]");
-    for (auto& element : all_elements.evaluate_node_set(model_->grammar())) {
-        do_walk(element.node(), "", 0);
+    for (auto& element : Stats::xpath(all_elements).evaluate_node_set(model_->grammar())) {
+        roots.push_back(element.node());
     }
+    return roots;
 }
+
+bool grammar::walker_base::independent_roots(const std::vector<pugi::xml_node>& roots) const
+{
+    std::unordered_set<std::string> names;
+    for (auto& root : roots) {
+        if (!names.insert(root.name()).second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template class grammar::basic_walker<grammar::walker>;
@@ -0,0 +1,76 @@
+//
+//  workers.cpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#include "workers.hpp"
+#include "error.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int Workers::jobs_ = 1;
+
+void Workers::set_jobs(int jobs)
+{
+    jobs_ = std::max(0, jobs);
+}
+
+int Workers::jobs()
+{
+    if (jobs_ == 0) {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+    return jobs_;
+}
+
+void Workers::run(size_t count, const std::function<void(size_t)>& task)
+{
+    size_t threads = std::min(count, static_cast<size_t>(jobs()));
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            task(i);
+        }
+        return;
+    }
+    // the tasks are taken in order by the first thread that is free; the
+    // first error stops the tasks not yet started, and it is reported on the
+    // calling thread once the others have ended, since ending the program
+    // would run the exit handlers while they are still walking
+    std::atomic<size_t> next(0);
+    std::mutex failure_mutex;
+    std::unique_ptr<Error::failure> failure;
+    auto worker = [&]() {
+        bool deferred = Error::defer(true);
+        try {
+            for (size_t i = next++; i < count; i = next++) {
+                task(i);
+            }
+        } catch (const Error::failure& error) {
+            std::lock_guard<std::mutex> lock(failure_mutex);
+            if (!failure) {
+                failure.reset(new Error::failure(error));
+            }
+            next = count;
+        }
+        Error::defer(deferred);
+    };
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) {
+        pool.push_back(std::thread(worker));
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    if (failure) {
+        Error::fatal(failure->message);
+    }
+}
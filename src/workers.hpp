@@ -0,0 +1,33 @@
+//
+//  workers.hpp
+//  grammar2code
+//
+//  This file is distributed under the BSD 2-Clause License. See LICENSE.TXT
+//  for details.
+//
+
+#ifndef __Grammar2Code__Workers__
+#define __Grammar2Code__Workers__
+
+#include <cstddef>
+#include <functional>
+
+// pool of threads running independent tasks, such as the walks of the output
+// derivations; with a single job the tasks run in order on the calling thread
+class Workers {
+public:
+    // 0 for one job per hardware thread
+    static void set_jobs(int jobs);
+
+    static int jobs();
+
+    // runs task(0), ..., task(count - 1) and returns when all of them have
+    // ended; the calling thread is one of the workers, and an Error::fatal in
+    // a task is reported on it after all the workers have ended
+    static void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    static int jobs_;
+};
+
+#endif /* defined(__Grammar2Code__Workers__) */